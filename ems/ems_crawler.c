@@ -225,8 +225,11 @@ void quote_fetch_success(emscripten_fetch_t *fetch) {
             continue;
         }
 
-        /* get quotes of quotes if there are any. */
-        get_quotes(did, post_id);
+        /* get quotes of quotes if there are any. the view tells us when there aren't */
+        json_object* quote_count;
+        if (!json_object_object_get_ex(post, "quoteCount", &quote_count) || json_object_get_int(quote_count) > 0) {
+            get_quotes(did, post_id);
+        }
 
         char* https_url = post_uri_to_https(post_uri);
         emscripten_log(EM_LOG_INFO, "%s", https_url);
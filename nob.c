@@ -37,8 +37,17 @@ void build_default(void) {
     nob_cmd_append(&cmd, STR_OR_DEFAULT(CC, DEFAULT_CC));
     nob_cmd_append(&cmd, "-O3");
     nob_cmd_append(&cmd, "-o", "out/main");
-    nob_cmd_append(&cmd, "src/main.c", "src/crawler.c");
-    nob_cmd_append(&cmd, "-lcurl", "-ljson-c", "-lpthread");
+    nob_cmd_append(&cmd, "src/main.c", "src/crawler.c", "src/estimate.c");
+    nob_cmd_append(&cmd, "src/queue.c", "src/strset.c", "src/ring.c", "src/iterator.c");
+    nob_cmd_append(&cmd, "src/writer.c", "src/tid.c", "src/intern.c", "src/snapshot.c", "src/database.c");
+    nob_cmd_append(&cmd, "src/live.c", "src/timeline.c", "src/aggregate.c", "src/didcache.c", "src/handles.c", "src/httpcache.c", "src/checkpoint.c", "src/snapdiff.c", "src/pagecache.c", "src/watch.c", "src/spill.c");
+    nob_cmd_append(&cmd, "-lcurl", "-ljson-c", "-lpthread", "-lm", "-lrt");
+
+    /* ZSTD=1 enables compressed output (-z), needs libzstd */
+    if (getenv("ZSTD")) nob_cmd_append(&cmd, "-DHAVE_ZSTD", "-lzstd");
+
+    /* SQLITE=1 enables database output (-D), needs libsqlite3 */
+    if (getenv("SQLITE")) nob_cmd_append(&cmd, "-DHAVE_SQLITE", "-lsqlite3");
 
     nob_cmd_run_sync(cmd);
 }
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "aggregate.h"
+#include "intern.h"
+
+/* min-heap of the best k posts seen so far. the weakest one sits at the root, ready to be pushed out */
+struct post_heap {
+    struct ranked_post* items;
+    int count;
+};
+
+struct author_totals {
+    int quotes;
+    long long quotes_received;
+    long long likes_received;
+};
+
+struct aggregator {
+    pthread_mutex_t mutex;
+    int k;
+    struct post_heap heaps[POST_METRICS];
+
+    struct intern_table authors; /* DID -> index into totals */
+    struct author_totals* totals;
+    size_t totals_capacity;
+};
+
+
+struct aggregator* aggregator_create(int k) {
+    struct aggregator* aggregator = calloc(1, sizeof(struct aggregator));
+    pthread_mutex_init(&aggregator->mutex, NULL);
+    aggregator->k = k > 0 ? k : 1;
+    for (int m = 0; m < POST_METRICS; m++) {
+        aggregator->heaps[m].items = calloc(aggregator->k, sizeof(struct ranked_post));
+    }
+    intern_init(&aggregator->authors);
+    return aggregator;
+}
+
+
+void aggregator_free(struct aggregator* aggregator) {
+    for (int m = 0; m < POST_METRICS; m++) {
+        ranked_posts_free(aggregator->heaps[m].items, aggregator->heaps[m].count);
+    }
+    intern_free(&aggregator->authors);
+    free(aggregator->totals);
+    pthread_mutex_destroy(&aggregator->mutex);
+    free(aggregator);
+}
+
+
+static void sift_down(struct ranked_post* items, int count, int i) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < count && items[left].score < items[smallest].score) smallest = left;
+        if (right < count && items[right].score < items[smallest].score) smallest = right;
+        if (smallest == i) return;
+
+        struct ranked_post swap = items[i];
+        items[i] = items[smallest];
+        items[smallest] = swap;
+        i = smallest;
+    }
+}
+
+
+static void sift_up(struct ranked_post* items, int i) {
+    while (i > 0 && items[(i - 1) / 2].score > items[i].score) {
+        struct ranked_post swap = items[i];
+        items[i] = items[(i - 1) / 2];
+        items[(i - 1) / 2] = swap;
+        i = (i - 1) / 2;
+    }
+}
+
+
+/* O(log k), and only when the post makes it in. most don't, and cost one comparison */
+static void offer(struct post_heap* heap, int k, const char* uri, int score) {
+    if (score < 0) return;
+
+    if (heap->count < k) {
+        heap->items[heap->count] = (struct ranked_post){ strdup(uri), score };
+        sift_up(heap->items, heap->count++);
+    } else if (score > heap->items[0].score) {
+        free(heap->items[0].uri);
+        heap->items[0] = (struct ranked_post){ strdup(uri), score };
+        sift_down(heap->items, heap->count, 0);
+    }
+}
+
+
+static void aggregate_result(void* userdata, const struct quote_result* result) {
+    struct aggregator* aggregator = userdata;
+    pthread_mutex_lock(&aggregator->mutex);
+
+    offer(&aggregator->heaps[BY_QUOTES], aggregator->k, result->uri, result->quote_count);
+    offer(&aggregator->heaps[BY_LIKES], aggregator->k, result->uri, result->like_count);
+
+    if (result->author_did) {
+        int id = intern_add(&aggregator->authors, result->author_did);
+        if ((size_t)id >= aggregator->totals_capacity) {
+            size_t capacity = aggregator->totals_capacity ? aggregator->totals_capacity * 2 : 256;
+            aggregator->totals = realloc(aggregator->totals, capacity * sizeof(struct author_totals));
+            memset(aggregator->totals + aggregator->totals_capacity, 0,
+                   (capacity - aggregator->totals_capacity) * sizeof(struct author_totals));
+            aggregator->totals_capacity = capacity;
+        }
+
+        struct author_totals* totals = &aggregator->totals[id];
+        totals->quotes++;
+        if (result->quote_count > 0) totals->quotes_received += result->quote_count;
+        if (result->like_count > 0) totals->likes_received += result->like_count;
+    }
+
+    pthread_mutex_unlock(&aggregator->mutex);
+}
+
+
+struct crawl_sink aggregator_sink(struct aggregator* aggregator) {
+    return (struct crawl_sink){
+        .on_result = aggregate_result,
+        .userdata = aggregator
+    };
+}
+
+
+static int by_score_desc(const void* a, const void* b) {
+    const struct ranked_post* x = a;
+    const struct ranked_post* y = b;
+    return (y->score > x->score) - (y->score < x->score);
+}
+
+
+int aggregator_top_posts(struct aggregator* aggregator, enum post_metric metric, struct ranked_post** posts) {
+    pthread_mutex_lock(&aggregator->mutex);
+    struct post_heap* heap = &aggregator->heaps[metric];
+    int count = heap->count;
+    *posts = calloc(count > 0 ? count : 1, sizeof(struct ranked_post));
+    for (int i = 0; i < count; i++) {
+        (*posts)[i] = (struct ranked_post){ strdup(heap->items[i].uri), heap->items[i].score };
+    }
+    pthread_mutex_unlock(&aggregator->mutex);
+
+    qsort(*posts, count, sizeof(struct ranked_post), by_score_desc);
+    return count;
+}
+
+
+/* author heap entry: index and quotes, ordered by quotes */
+struct author_entry {
+    int id;
+    int quotes;
+};
+
+static int by_quotes_desc(const void* a, const void* b) {
+    const struct author_entry* x = a;
+    const struct author_entry* y = b;
+    return (y->quotes > x->quotes) - (y->quotes < x->quotes);
+}
+
+
+int aggregator_top_authors(struct aggregator* aggregator, int k, struct ranked_author** authors) {
+    pthread_mutex_lock(&aggregator->mutex);
+
+    /* same min-heap trick over every author: O(authors log k) instead of sorting them all */
+    int n = (int)aggregator->authors.count;
+    if (k > n) k = n;
+    struct author_entry* heap = calloc(k > 0 ? k : 1, sizeof(struct author_entry));
+    int count = 0;
+
+    for (int id = 0; id < n; id++) {
+        int quotes = aggregator->totals[id].quotes;
+        int i;
+        if (count < k) {
+            i = count++;
+        } else if (quotes > heap[0].quotes) {
+            i = 0;
+        } else {
+            continue;
+        }
+        heap[i] = (struct author_entry){ id, quotes };
+
+        /* restore heap order, up from a fresh leaf or down from a replaced root */
+        while (i > 0 && heap[(i - 1) / 2].quotes > heap[i].quotes) {
+            struct author_entry swap = heap[i]; heap[i] = heap[(i - 1) / 2]; heap[(i - 1) / 2] = swap;
+            i = (i - 1) / 2;
+        }
+        for (;;) {
+            int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+            if (left < count && heap[left].quotes < heap[smallest].quotes) smallest = left;
+            if (right < count && heap[right].quotes < heap[smallest].quotes) smallest = right;
+            if (smallest == i) break;
+            struct author_entry swap = heap[i]; heap[i] = heap[smallest]; heap[smallest] = swap;
+            i = smallest;
+        }
+    }
+    qsort(heap, count, sizeof(struct author_entry), by_quotes_desc);
+
+    *authors = calloc(count > 0 ? count : 1, sizeof(struct ranked_author));
+    for (int i = 0; i < count; i++) {
+        struct author_totals* totals = &aggregator->totals[heap[i].id];
+        (*authors)[i] = (struct ranked_author){
+            .did = strdup(intern_string(&aggregator->authors, heap[i].id)),
+            .quotes = totals->quotes,
+            .quotes_received = totals->quotes_received,
+            .likes_received = totals->likes_received
+        };
+    }
+
+    pthread_mutex_unlock(&aggregator->mutex);
+    free(heap);
+    return count;
+}
+
+
+void ranked_posts_free(struct ranked_post* posts, int count) {
+    for (int i = 0; i < count; i++) free(posts[i].uri);
+    free(posts);
+}
+
+
+void ranked_authors_free(struct ranked_author* authors, int count) {
+    for (int i = 0; i < count; i++) free(authors[i].did);
+    free(authors);
+}
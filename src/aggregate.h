@@ -0,0 +1,48 @@
+#ifndef   __AGGREGATE_H__
+#define   __AGGREGATE_H__
+
+#include "crawler.h"
+
+/* what posts get ranked by */
+enum post_metric {
+    BY_QUOTES, /* quoteCount */
+    BY_LIKES,  /* likeCount */
+    POST_METRICS
+};
+
+struct ranked_post {
+    char* uri;
+    int score;
+};
+
+/* how an author figures in a cascade */
+struct ranked_author {
+    char* did;
+    int quotes;                  /* quotes they posted in the cascade */
+    long long quotes_received;   /* sum of quoteCount over those */
+    long long likes_received;    /* sum of likeCount over those */
+};
+
+/* keeps the top `k` posts per metric in min-heaps, and per-author totals in a hash table keyed by
+ * interned DID, updated as results come in. memory is O(k + authors). safe to query from any
+ * thread while the crawl is still running */
+struct aggregator;
+
+struct aggregator* aggregator_create(int k);
+void aggregator_free(struct aggregator* aggregator);
+
+/* a sink feeding the aggregator */
+struct crawl_sink aggregator_sink(struct aggregator* aggregator);
+
+/* the current top posts by `metric`, best first. returns how many, at most k.
+ * `*posts` is to be freed with ranked_posts_free() */
+int aggregator_top_posts(struct aggregator* aggregator, enum post_metric metric, struct ranked_post** posts);
+
+/* the current top `k` authors by quotes posted, best first. returns how many.
+ * `*authors` is to be freed with ranked_authors_free() */
+int aggregator_top_authors(struct aggregator* aggregator, int k, struct ranked_author** authors);
+
+void ranked_posts_free(struct ranked_post* posts, int count);
+void ranked_authors_free(struct ranked_author* authors, int count);
+
+#endif /* __AGGREGATE_H__ */
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+#include "intern.h"
+#include "strset.h"
+
+#define CHECKPOINT_HEADER "QCCHECKPOINT\t1\n"
+
+struct checkpoint {
+    FILE* file;
+    double interval;
+    double synced_at;
+};
+
+/* what replaying a journal keeps track of, per post or leaf id */
+struct replay_item {
+    char* cursor;
+    int depth;
+    int finished;
+};
+
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* id of post `uri` in `table`, with room for it in `*items` */
+static int replay_add(struct intern_table* table, struct replay_item** items, const char* uri) {
+    size_t count = table->count;
+    int id = intern_add(table, uri);
+    if (table->count != count) {
+        *items = realloc(*items, table->count * sizeof(struct replay_item));
+        (*items)[id] = (struct replay_item){0};
+    }
+    return id;
+}
+
+
+/* split a line into up to `max` tab-separated fields in place. returns how many */
+static int split_fields(char* line, char** fields, int max) {
+    int count = 0;
+    char* field;
+    while (count < max && (field = strsep(&line, "\t")) != NULL) fields[count++] = field;
+    return count;
+}
+
+
+/* replay the journal in `file` into `restore`. returns the offset right after its last complete line */
+static long replay(FILE* file, struct checkpoint_restore* restore) {
+    struct intern_table posts;
+    struct replay_item* post_items = NULL;
+    struct strset revalidated;
+    struct intern_table counted; /* posts with a C line, and the count of the last one */
+    int* counts = NULL;
+    intern_init(&posts);
+    strset_init(&revalidated);
+    intern_init(&counted);
+
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+    long end = 0;
+    while ((len = getline(&line, &line_size, file)) > 0) {
+        if (line[len - 1] != '\n') break;
+        line[len - 1] = '\0';
+        if (end == 0) {
+            end = len;
+            continue; /* the header */
+        }
+        end += len;
+
+        char* f[7];
+        int n = split_fields(line, f, 7);
+        int id;
+        if (n == 3 && strcmp(f[0], "E") == 0) {
+            /* an incremental crawl expands finished posts again */
+            id = replay_add(&posts, &post_items, f[1]);
+            free(post_items[id].cursor);
+            post_items[id] = (struct replay_item){ .depth = atoi(f[2]) };
+        } else if (n == 3 && strcmp(f[0], "P") == 0) {
+            id = replay_add(&posts, &post_items, f[1]);
+            free(post_items[id].cursor);
+            post_items[id].cursor = strdup(f[2]);
+        } else if (n == 2 && strcmp(f[0], "D") == 0) {
+            id = replay_add(&posts, &post_items, f[1]);
+            post_items[id].finished = 1;
+        } else if (n == 7 && strcmp(f[0], "Q") == 0) {
+            restore->quotes = realloc(restore->quotes, (restore->quotes_count + 1) * sizeof(struct restored_quote));
+            restore->quotes[restore->quotes_count++] = (struct restored_quote){
+                .uri = strdup(f[1]),
+                .parent_uri = strdup(f[2]),
+                .author_did = f[3][0] ? strdup(f[3]) : NULL,
+                .depth = atoi(f[4]),
+                .quote_count = atoi(f[5]),
+                .like_count = atoi(f[6])
+            };
+        } else if (n == 2 && strcmp(f[0], "V") == 0) {
+            strset_insert(&revalidated, f[1]);
+        } else if (n == 3 && strcmp(f[0], "C") == 0) {
+            size_t count = counted.count;
+            id = intern_add(&counted, f[1]);
+            if (counted.count != count) counts = realloc(counts, counted.count * sizeof(int));
+            counts[id] = atoi(f[2]);
+        }
+    }
+    free(line);
+
+    restore->expanded = malloc((posts.count > 0 ? posts.count : 1) * sizeof(char*));
+    restore->open = malloc((posts.count > 0 ? posts.count : 1) * sizeof(struct restored_post));
+    for (size_t i = 0; i < posts.count; i++) {
+        restore->expanded[restore->expanded_count++] = strdup(intern_string(&posts, i));
+        if (post_items[i].finished) {
+            free(post_items[i].cursor);
+            continue;
+        }
+        restore->open[restore->open_count++] = (struct restored_post){
+            strdup(intern_string(&posts, i)), post_items[i].cursor, post_items[i].depth
+        };
+    }
+
+    restore->leaves = malloc((restore->quotes_count > 0 ? restore->quotes_count : 1) * sizeof(struct restored_post));
+    for (int i = 0; i < restore->quotes_count; i++) {
+        const struct restored_quote* quote = &restore->quotes[i];
+        if (quote->quote_count != 0 || strset_contains(&revalidated, quote->uri)) continue;
+        restore->leaves[restore->leaves_count++] = (struct restored_post){ strdup(quote->uri), NULL, quote->depth };
+    }
+
+    /* roots are the posts expanded at depth 0, everything else the journal knows is a quote */
+    struct intern_table nodes;
+    intern_init(&nodes);
+    restore->nodes = malloc((posts.count + restore->quotes_count + 1) * sizeof(struct restored_node));
+    for (size_t i = 0; i < posts.count; i++) {
+        if (post_items[i].depth != 0 || intern_find(&nodes, intern_string(&posts, i)) >= 0) continue;
+        intern_add(&nodes, intern_string(&posts, i));
+        restore->nodes[restore->nodes_count++] = (struct restored_node){ strdup(intern_string(&posts, i)), 0, -1, 0 };
+    }
+    for (int i = 0; i < restore->quotes_count; i++) {
+        const struct restored_quote* quote = &restore->quotes[i];
+        if (intern_find(&nodes, quote->uri) >= 0) continue;
+        intern_add(&nodes, quote->uri);
+        restore->nodes[restore->nodes_count++] = (struct restored_node){
+            strdup(quote->uri), quote->depth, quote->quote_count, 0
+        };
+    }
+    for (int i = 0; i < restore->quotes_count; i++) {
+        int parent = intern_find(&nodes, restore->quotes[i].parent_uri);
+        if (parent >= 0) restore->nodes[parent].children++;
+    }
+    for (int i = 0; i < restore->nodes_count; i++) {
+        int id = intern_find(&counted, restore->nodes[i].uri);
+        if (id >= 0) restore->nodes[i].quote_count = counts[id];
+    }
+    intern_free(&nodes);
+
+    free(post_items);
+    intern_free(&posts);
+    strset_free(&revalidated);
+    intern_free(&counted);
+    free(counts);
+    return end;
+}
+
+
+struct checkpoint* checkpoint_open(const char* path, double interval_seconds, int resume,
+                                   struct checkpoint_restore* restore) {
+    *restore = (struct checkpoint_restore){0};
+
+    FILE* file = NULL;
+    if (resume && (file = fopen(path, "r+")) != NULL) {
+        char header[sizeof(CHECKPOINT_HEADER)];
+        if (fgets(header, sizeof(header), file) == NULL || strcmp(header, CHECKPOINT_HEADER) != 0) {
+            fprintf(stderr, "%s: not a version 1 checkpoint\n", path);
+            fclose(file);
+            return NULL;
+        }
+        rewind(file);
+
+        /* whatever a crash left after the last complete line goes, new lines go after it */
+        long end = replay(file, restore);
+        if (ftruncate(fileno(file), end) != 0 || fseek(file, end, SEEK_SET) != 0) {
+            perror(path);
+            checkpoint_restore_free(restore);
+            fclose(file);
+            return NULL;
+        }
+    } else {
+        file = fopen(path, "w");
+        if (file == NULL) {
+            perror(path);
+            return NULL;
+        }
+        fputs(CHECKPOINT_HEADER, file);
+    }
+
+    struct checkpoint* checkpoint = calloc(1, sizeof(struct checkpoint));
+    checkpoint->file = file;
+    checkpoint->interval = interval_seconds > 0 ? interval_seconds : DEFAULT_CHECKPOINT_INTERVAL;
+    checkpoint->synced_at = monotonic_now();
+    return checkpoint;
+}
+
+
+static void sync_journal(struct checkpoint* checkpoint) {
+    if (fflush(checkpoint->file) != 0 || fdatasync(fileno(checkpoint->file)) != 0) perror("checkpoint");
+    checkpoint->synced_at = monotonic_now();
+}
+
+
+void checkpoint_close(struct checkpoint* checkpoint) {
+    if (checkpoint == NULL) return;
+    sync_journal(checkpoint);
+    fclose(checkpoint->file);
+    free(checkpoint);
+}
+
+
+void checkpoint_restore_free(struct checkpoint_restore* restore) {
+    for (int i = 0; i < restore->quotes_count; i++) {
+        free(restore->quotes[i].uri);
+        free(restore->quotes[i].parent_uri);
+        free(restore->quotes[i].author_did);
+    }
+    free(restore->quotes);
+    for (int i = 0; i < restore->expanded_count; i++) free(restore->expanded[i]);
+    free(restore->expanded);
+    for (int i = 0; i < restore->open_count; i++) {
+        free(restore->open[i].uri);
+        free(restore->open[i].cursor);
+    }
+    free(restore->open);
+    for (int i = 0; i < restore->leaves_count; i++) free(restore->leaves[i].uri);
+    free(restore->leaves);
+    for (int i = 0; i < restore->nodes_count; i++) free(restore->nodes[i].uri);
+    free(restore->nodes);
+    *restore = (struct checkpoint_restore){0};
+}
+
+
+/* a line was written. force the journal to disk if it's been a while */
+static void journal_done(struct checkpoint* checkpoint) {
+    if (monotonic_now() - checkpoint->synced_at >= checkpoint->interval) sync_journal(checkpoint);
+}
+
+
+void checkpoint_expanded(struct checkpoint* checkpoint, const char* uri, int depth) {
+    fprintf(checkpoint->file, "E\t%s\t%d\n", uri, depth);
+    journal_done(checkpoint);
+}
+
+
+void checkpoint_page(struct checkpoint* checkpoint, const char* uri, const char* next_cursor) {
+    if (next_cursor) {
+        fprintf(checkpoint->file, "P\t%s\t%s\n", uri, next_cursor);
+    } else {
+        fprintf(checkpoint->file, "D\t%s\n", uri);
+    }
+    journal_done(checkpoint);
+}
+
+
+void checkpoint_quote(struct checkpoint* checkpoint, const struct quote_result* result) {
+    fprintf(checkpoint->file, "Q\t%s\t%s\t%s\t%d\t%d\t%d\n", result->uri, result->parent_uri,
+            result->author_did ? result->author_did : "", result->depth, result->quote_count, result->like_count);
+    journal_done(checkpoint);
+}
+
+
+void checkpoint_revalidated(struct checkpoint* checkpoint, const char* uri) {
+    fprintf(checkpoint->file, "V\t%s\n", uri);
+    journal_done(checkpoint);
+}
+
+
+void checkpoint_count(struct checkpoint* checkpoint, const char* uri, int quote_count) {
+    fprintf(checkpoint->file, "C\t%s\t%d\n", uri, quote_count);
+    journal_done(checkpoint);
+}
@@ -0,0 +1,83 @@
+#ifndef   __CHECKPOINT_H__
+#define   __CHECKPOINT_H__
+
+#include "crawler.h"
+
+/* how often the journal is forced to disk unless told otherwise, in seconds */
+#define DEFAULT_CHECKPOINT_INTERVAL 5
+
+/*
+ * journal of a crawl, one tab-separated line per event:
+ *
+ *   E uri depth                          the first getQuotes page of a post is due
+ *   P uri cursor                         a page of it is done, the next one is at `cursor`
+ *   D uri                                every page of it is done
+ *   Q uri parent author depth quotes likes   a quote got collected
+ *   V uri                                a quote with a quoteCount of 0 had it revalidated
+ *   C uri count                          quoteCount of a post, as an incremental crawl last saw it
+ *
+ * every prefix of the journal is a state the crawl can pick up from: work that was done but not
+ * journaled yet is just done again, and dedupe takes care of the results it repeats. the journal
+ * is flushed and fsync()ed every so often, and a line cut short by a crash is ignored
+ */
+struct checkpoint;
+
+/* a quote read back from a journal */
+struct restored_quote {
+    char* uri;
+    char* parent_uri;
+    char* author_did; /* NULL if it wasn't known */
+    int depth;
+    int quote_count;
+    int like_count;
+};
+
+/* a post read back from a journal */
+struct restored_post {
+    char* uri;
+    char* cursor; /* page to continue at, NULL for the first one */
+    int depth;
+};
+
+/* a post the journal knows, root or quote */
+struct restored_node {
+    char* uri;
+    int depth;
+    int quote_count; /* as last seen, -1 if it never was */
+    int children;    /* its quotes that got collected */
+};
+
+/* everything a journal says about a crawl */
+struct checkpoint_restore {
+    struct restored_quote* quotes; /* in the order they were collected */
+    int quotes_count;
+    char** expanded;               /* every post ever expanded, done or not */
+    int expanded_count;
+    struct restored_post* open;    /* expanded posts with pages still to fetch */
+    int open_count;
+    struct restored_post* leaves;  /* quotes with a quoteCount of 0 that weren't revalidated */
+    int leaves_count;
+    struct restored_node* nodes;   /* roots and quotes, roots first */
+    int nodes_count;
+};
+
+/* start journaling to `path`. with `resume`, whatever the file already holds is read into
+ * `*restore` first and the journal continues after it, otherwise the file starts over.
+ * `interval_seconds` <= 0 picks DEFAULT_CHECKPOINT_INTERVAL. returns NULL if the file can't be used */
+struct checkpoint* checkpoint_open(const char* path, double interval_seconds, int resume,
+                                   struct checkpoint_restore* restore);
+
+/* forces everything to disk */
+void checkpoint_close(struct checkpoint* checkpoint);
+void checkpoint_restore_free(struct checkpoint_restore* restore);
+
+void checkpoint_expanded(struct checkpoint* checkpoint, const char* uri, int depth);
+
+/* a page of `uri` is done. `next_cursor` is NULL if it was the last one */
+void checkpoint_page(struct checkpoint* checkpoint, const char* uri, const char* next_cursor);
+
+void checkpoint_quote(struct checkpoint* checkpoint, const struct quote_result* result);
+void checkpoint_revalidated(struct checkpoint* checkpoint, const char* uri);
+void checkpoint_count(struct checkpoint* checkpoint, const char* uri, int quote_count);
+
+#endif /* __CHECKPOINT_H__ */
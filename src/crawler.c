@@ -2,11 +2,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include <curl/curl.h>
 #include <json-c/json.h>
 
 #include "crawler.h"
+#include "queue.h"
+#include "strset.h"
+#include "didcache.h"
+#include "httpcache.h"
+#include "checkpoint.h"
+#include "pagecache.h"
+#include "spill.h"
 
 /* useragent to use for requests */
 #define REQ_USERAGENT "libcurl-agent/1.0"
@@ -20,13 +31,115 @@
 /* AT protocol string. used inplace of http/https */
 #define ATPROTO "at://"
 
-CURL *curl; /* internal curl instance. don't touch */
-CURLM *multi_handle; /* multi handle for asynchronous requests. don't touch */
+/* base of all XRPC endpoints we talk to */
+#ifndef API_BASE
+#define API_BASE "https://public.api.bsky.app/xrpc/"
+#endif
 
+/* app.bsky.feed.getPosts accepts at most this many URIs per call */
+#define GET_POSTS_BATCH 25
 
+/* app.bsky.actor.getProfiles accepts at most this many actors per call */
+#define GET_PROFILES_BATCH 25
 
-/* we need to signal main thread somehow */
-extern void signal_main_thread(void);
+/* largest page app.bsky.feed.getQuotes hands out */
+#define GET_QUOTES_LIMIT 100
+
+/* transfers the network stage keeps going at once unless told otherwise */
+#define DEFAULT_MAX_IN_FLIGHT 16
+
+/* upper bound for the default number of parse workers */
+#define MAX_DEFAULT_PARSE_WORKERS 8
+
+/* bytes of json-c tree per byte of response, roughly. measured on getQuotes pages */
+#define JSON_TREE_COST 8
+
+/* seconds a crawl over its memory budget gives a step time to pay off before taking the next one */
+#define MEMORY_STEP_INTERVAL 1
+
+/* least memory a crawl over its memory budget leaves its frontier */
+#define MIN_FRONTIER_MEMORY 4096
+
+/* where the bytes of a subsystem went. updated from every crawl thread */
+struct memory_account {
+    atomic_size_t live;
+    atomic_size_t peak;
+    atomic_size_t allocations;
+    atomic_size_t frees;
+};
+
+/* everything a crawl needs. nothing in here is shared between crawlers */
+struct crawler {
+    struct crawler_config config;
+
+    CURL *curl;          /* for one-off blocking requests */
+    CURLM *multi_handle; /* for batches of blocking requests. crawls bring their own */
+
+    /* set by cancel_quote_search(), checked between requests and by in-flight transfers */
+    atomic_int cancel_requested;
+
+    /* set when a budget ran out, so in-flight transfers get aborted too */
+    atomic_int stopping;
+
+    /* monotonic deadline of the running crawl in seconds, 0 if there is none.
+     * in-flight transfers are aborted once it passes */
+    _Atomic double deadline;
+
+    /* handle -> DID answers from earlier runs, NULL without a cache file */
+    struct did_cache* did_cache;
+
+    /* refreshes stale DID cache entries while the crawl goes on, one after another. the thread
+     * quits when it runs out of handles, and the next stale lookup starts another */
+    pthread_mutex_t refresh_mutex;
+    pthread_t refresh_thread;
+    int refresh_started; /* there is a thread to join */
+    int refreshing;      /* and it's still taking handles */
+    char** refresh_handles;
+    int refresh_count;
+
+    /* crawl responses from earlier runs, NULL without a cache file */
+    struct http_cache* http_cache;
+
+    /* memory of the running or last crawl */
+    struct memory_account memory[MEMORY_SUBSYSTEMS];
+};
+
+
+static void memory_charge(struct crawler* crawler, enum memory_subsystem subsystem, size_t bytes, size_t allocations) {
+    struct memory_account* account = &crawler->memory[subsystem];
+    size_t live = atomic_fetch_add(&account->live, bytes) + bytes;
+    atomic_fetch_add(&account->allocations, allocations);
+
+    size_t peak = atomic_load(&account->peak);
+    while (live > peak && !atomic_compare_exchange_weak(&account->peak, &peak, live));
+}
+
+
+static void memory_release(struct crawler* crawler, enum memory_subsystem subsystem, size_t bytes, size_t frees) {
+    struct memory_account* account = &crawler->memory[subsystem];
+    atomic_fetch_sub(&account->live, bytes);
+    atomic_fetch_add(&account->frees, frees);
+}
+
+
+/* what the crawl holds that it could do without. dedupe keys and results only ever grow */
+static size_t memory_sheddable(struct crawler* crawler) {
+    return atomic_load(&crawler->memory[MEMORY_FRONTIER].live)
+         + atomic_load(&crawler->memory[MEMORY_RESPONSES].live)
+         + atomic_load(&crawler->memory[MEMORY_JSON].live);
+}
+
+
+void crawler_get_memory(struct crawler* crawler, struct memory_usage usage[MEMORY_SUBSYSTEMS]) {
+    for (int i = 0; i < MEMORY_SUBSYSTEMS; i++) {
+        usage[i] = (struct memory_usage){
+            .live = atomic_load(&crawler->memory[i].live),
+            .peak = atomic_load(&crawler->memory[i].peak),
+            .allocations = atomic_load(&crawler->memory[i].allocations),
+            .frees = atomic_load(&crawler->memory[i].frees)
+        };
+    }
+}
 
 char* extract_post_id(const char* post_url) {
     const char* last_slash = strrchr(post_url, '/');
@@ -101,33 +214,81 @@ static size_t WriteMemoryCallback(void *contents, size_t size, size_t nmemb, voi
 
 
 void shared_curl_init(void) {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    curl = curl_easy_init();
-    multi_handle = curl_multi_init();
-    if (!curl || !multi_handle) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
         fprintf(stderr, "Failed to initialize cURL\n");
         exit(1);
     }
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, REQ_USERAGENT);
 }
 
 
 void shared_curl_destroy(void) {
-    curl_easy_cleanup(curl);
-    curl_multi_cleanup(multi_handle);
     curl_global_cleanup();
 }
 
 
-char* get_did(const char *actor) {
+struct crawler* crawler_create(const struct crawler_config* config) {
+    struct crawler* crawler = calloc(1, sizeof(struct crawler));
+    if (config) crawler->config = *config;
+    pthread_mutex_init(&crawler->refresh_mutex, NULL);
+
+    crawler->curl = curl_easy_init();
+    crawler->multi_handle = curl_multi_init();
+    if (!crawler->curl || !crawler->multi_handle) {
+        fprintf(stderr, "Failed to initialize cURL\n");
+        crawler_destroy(crawler);
+        return NULL;
+    }
+    curl_easy_setopt(crawler->curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(crawler->curl, CURLOPT_USERAGENT, REQ_USERAGENT);
+
+    atomic_init(&crawler->cancel_requested, 0);
+    atomic_init(&crawler->stopping, 0);
+    atomic_init(&crawler->deadline, 0);
+
+    /* without its cache the crawler still works, just slower to start */
+    if (crawler->config.did_cache_path) {
+        crawler->did_cache = did_cache_open(crawler->config.did_cache_path, crawler->config.did_cache_ttl);
+    }
+    if (crawler->config.http_cache_path) {
+        crawler->http_cache = http_cache_open(crawler->config.http_cache_path, crawler->config.http_cache_ttl);
+    }
+    return crawler;
+}
+
+
+void crawler_destroy(struct crawler* crawler) {
+    if (crawler == NULL) return;
+    /* the refresher finishes what's queued, so the cache file gets the answers */
+    if (crawler->refresh_started) pthread_join(crawler->refresh_thread, NULL);
+    free(crawler->refresh_handles);
+    pthread_mutex_destroy(&crawler->refresh_mutex);
+    did_cache_close(crawler->did_cache);
+    http_cache_close(crawler->http_cache);
+    if (crawler->curl) curl_easy_cleanup(crawler->curl);
+    if (crawler->multi_handle) curl_multi_cleanup(crawler->multi_handle);
+    free(crawler);
+}
+
+
+const struct crawler_config* crawler_get_config(const struct crawler* crawler) {
+    return &crawler->config;
+}
+
+
+void crawler_set_config(struct crawler* crawler, const struct crawler_config* config) {
+    crawler->config = *config;
+}
+
+
+/* app.bsky.actor.getProfile for `actor` through `curl`. NULL if it failed */
+static char* fetch_did(CURL* curl, const char* actor) {
     CURLcode res;
     struct MemoryStruct chunk = init_MemoryStruct();
 
-    char* result = "unk";
+    char* result = NULL;
 
     char url[128 + MAX_ACTOR_LENGTH];
-    snprintf(url, sizeof(url), "https://public.api.bsky.app/xrpc/app.bsky.actor.getProfile?actor=%s", actor);
+    snprintf(url, sizeof(url), API_BASE "app.bsky.actor.getProfile?actor=%s", actor);
 
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk);
@@ -154,7 +315,6 @@ char* get_did(const char *actor) {
     if (json_object_object_get_ex(parsed_json, "did", &did_obj)) {
         const char *did = json_object_get_string(did_obj);
         result = strdup(did);
-        json_object_put(did_obj);
     }
 
     json_object_put(parsed_json);
@@ -164,64 +324,332 @@ char* get_did(const char *actor) {
 }
 
 
-/* add a quote request to our curl-multi */
-void add_quote_request(const char* actor_did, const char* post_id, struct MemoryStruct *chunk) {
-    char url[256];
-    snprintf(url, sizeof(url), "https://public.api.bsky.app/xrpc/app.bsky.feed.getQuotes?uri=%s%s/app.bsky.feed.post/%s", ATPROTO, actor_did, post_id);
+/* background refresh of stale cache entries, on its own connection. runs until none are queued */
+static void* refresh_did(void* arg) {
+    struct crawler* crawler = arg;
+
+    CURL* curl = curl_easy_init();
+    if (curl) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, REQ_USERAGENT);
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&crawler->refresh_mutex);
+        if (crawler->refresh_count == 0) {
+            crawler->refreshing = 0;
+            pthread_mutex_unlock(&crawler->refresh_mutex);
+            break;
+        }
+        char* handle = crawler->refresh_handles[--crawler->refresh_count];
+        pthread_mutex_unlock(&crawler->refresh_mutex);
+
+        char* did = curl ? fetch_did(curl, handle) : NULL;
+        if (did) did_cache_store(crawler->did_cache, handle, did);
+        free(did);
+        free(handle);
+    }
+
+    if (curl) curl_easy_cleanup(curl);
+    return NULL;
+}
 
+
+/* check `handle` behind the caller's back, starting the refresher if it isn't running */
+static void queue_refresh(struct crawler* crawler, const char* handle) {
+    pthread_mutex_lock(&crawler->refresh_mutex);
+    crawler->refresh_handles = realloc(crawler->refresh_handles, (crawler->refresh_count + 1) * sizeof(char*));
+    crawler->refresh_handles[crawler->refresh_count++] = strdup(handle);
+
+    if (!crawler->refreshing) {
+        /* the last refresher is done taking handles, so it's about to return if it hasn't yet */
+        if (crawler->refresh_started) pthread_join(crawler->refresh_thread, NULL);
+        crawler->refresh_started = crawler->refreshing =
+            pthread_create(&crawler->refresh_thread, NULL, refresh_did, crawler) == 0;
+        if (!crawler->refreshing) free(crawler->refresh_handles[--crawler->refresh_count]);
+    }
+    pthread_mutex_unlock(&crawler->refresh_mutex);
+}
+
+
+char* get_did(struct crawler* crawler, const char *actor) {
+    /* already a DID, nothing to resolve */
+    if (strncmp(actor, "did:", 4) == 0) return strdup(actor);
+
+    if (crawler->did_cache) {
+        int stale = 0;
+        char* did = did_cache_lookup(crawler->did_cache, actor, &stale);
+
+        /* a stale DID is almost always still right. use it now, check it behind our back */
+        if (did && stale) queue_refresh(crawler, actor);
+        if (did) return did;
+    }
+
+    char* did = fetch_did(crawler->curl, actor);
+    if (did == NULL) return strdup("unk");
+
+    if (crawler->did_cache) did_cache_store(crawler->did_cache, actor, did);
+    return did;
+}
+
+
+/* seconds on the monotonic clock */
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* whether the running crawl should stop: cancelled or past its deadline */
+static int crawl_expired(struct crawler* crawler) {
+    if (atomic_load(&crawler->cancel_requested) || atomic_load(&crawler->stopping)) return 1;
+    double deadline = crawler->deadline;
+    return deadline > 0 && monotonic_now() >= deadline;
+}
+
+
+/* progress callback of every transfer. returning non-zero makes curl abort it */
+static int TransferProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+                                    curl_off_t ultotal, curl_off_t ulnow) {
+    (void)dltotal;
+    (void)dlnow;
+    (void)ultotal;
+    (void)ulnow;
+    return crawl_expired(clientp);
+}
+
+
+/* easy handle fetching `url` into `chunk`. aborts itself when the crawl of `crawler` stops */
+static CURL* new_transfer(struct crawler* crawler, const char* url, struct MemoryStruct *chunk) {
     CURL *easy_handle = curl_easy_init();
     curl_easy_setopt(easy_handle, CURLOPT_URL, url);
+    curl_easy_setopt(easy_handle, CURLOPT_USERAGENT, REQ_USERAGENT);
     curl_easy_setopt(easy_handle, CURLOPT_WRITEDATA, (void*)chunk);
     curl_easy_setopt(easy_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_multi_add_handle(multi_handle, easy_handle);
+    curl_easy_setopt(easy_handle, CURLOPT_XFERINFOFUNCTION, TransferProgressCallback);
+    curl_easy_setopt(easy_handle, CURLOPT_XFERINFODATA, (void*)crawler);
+    curl_easy_setopt(easy_handle, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(easy_handle, CURLOPT_PRIVATE, (void*)chunk);
+    return easy_handle;
+}
+
+
+/* add a request for `url` to the crawler's curl-multi, response body goes into `chunk` */
+static void add_request(struct crawler* crawler, const char* url, struct MemoryStruct *chunk) {
+    curl_multi_add_handle(crawler->multi_handle, new_transfer(crawler, url, chunk));
+}
+
+
+/* add a quote request to the crawler's curl-multi */
+static void add_quote_request(struct crawler* crawler, const char* actor_did, const char* post_id, struct MemoryStruct *chunk) {
+    char url[256];
+    snprintf(url, sizeof(url), API_BASE "app.bsky.feed.getQuotes?uri=%s%s/app.bsky.feed.post/%s", ATPROTO, actor_did, post_id);
+    add_request(crawler, url, chunk);
 }
 
 
-/* process completed curl-multi requests */
-void process_completed_requests(void) {
+/* run every request on `multi_handle` to completion */
+static void run_requests(CURLM *multi_handle) {
     int still_running = 0;
     do {
         curl_multi_perform(multi_handle, &still_running);
+        /* sleep until there is socket activity instead of spinning */
+        if (still_running) curl_multi_poll(multi_handle, NULL, 0, 100, NULL);
     } while (still_running);
 
     CURLMsg *msg;
     int msgs_left;
     while ((msg = curl_multi_info_read(multi_handle, &msgs_left))) {
         if (msg->msg == CURLMSG_DONE) {
-            struct MemoryStruct *chunk;
-            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &chunk);
+            /* whatever an aborted transfer left in its buffer is not a usable body */
+            if (msg->data.result != CURLE_OK) {
+                struct MemoryStruct *chunk;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&chunk);
+                if (msg->data.result != CURLE_ABORTED_BY_CALLBACK) {
+                    fprintf(stderr, "request failed: %s\n", curl_easy_strerror(msg->data.result));
+                }
+                if (chunk) chunk->size = 0;
+            }
             curl_multi_remove_handle(multi_handle, msg->easy_handle);
             curl_easy_cleanup(msg->easy_handle);
-            free(chunk);
         }
     }
 }
 
 
-/* get quotes from a post */
-json_object* get_quotes(const char* actor_did, const char* post_id) {
-    struct MemoryStruct chunk = init_MemoryStruct();
-    add_quote_request(actor_did, post_id, &chunk);
-    process_completed_requests();
+/* process completed requests of the crawler's curl-multi */
+static void process_completed_requests(struct crawler* crawler) {
+    run_requests(crawler->multi_handle);
+}
+
 
+/* parse a finished response body. frees the body */
+static json_object* parse_response(struct MemoryStruct *chunk, const char* who) {
     json_object *json_response = NULL;
-    if (chunk.size > 0) {
-        json_response = json_tokener_parse(chunk.memory);
+    if (chunk->size > 0) {
+        json_response = json_tokener_parse(chunk->memory);
         if (json_response == NULL) {
-            fprintf(stderr, "failed to parse JSON response from get_quotes()\n");
+            fprintf(stderr, "failed to parse JSON response from %s()\n", who);
         }
     }
-    free(chunk.memory);
+    free(chunk->memory);
+    chunk->memory = NULL;
+    chunk->size = 0;
     return json_response;
 }
 
 
-/* check if quote was already visited */
-int is_visited(const char* post_identifier, char** visited, int visited_count) {
-    for (int i = 0; i < visited_count; i++) {
-        if (strcmp(visited[i], post_identifier) == 0) return 1;
+json_object* get_quotes(struct crawler* crawler, const char* actor_did, const char* post_id) {
+    struct MemoryStruct chunk = init_MemoryStruct();
+    add_quote_request(crawler, actor_did, post_id, &chunk);
+    process_completed_requests(crawler);
+    return parse_response(&chunk, "get_quotes");
+}
+
+
+int get_quote_count(json_object* post) {
+    json_object* count;
+    if (!json_object_object_get_ex(post, "quoteCount", &count)) return -1;
+    return json_object_get_int(count);
+}
+
+
+/* app.bsky.feed.getPosts url looking up `uris_count` (at most GET_POSTS_BATCH) URIs */
+static char* posts_url(const char* const* uris, int uris_count) {
+    size_t url_size = sizeof(API_BASE "app.bsky.feed.getPosts?");
+    for (int i = 0; i < uris_count; i++) url_size += strlen("uris=&") + strlen(uris[i]);
+    char* url = malloc(url_size);
+
+    char* p = url + sprintf(url, API_BASE "app.bsky.feed.getPosts?");
+    for (int i = 0; i < uris_count; i++) {
+        p += sprintf(p, "%suris=%s", i == 0 ? "" : "&", uris[i]);
+    }
+    return url;
+}
+
+
+/* all batches are in flight at once */
+void get_quote_counts(struct crawler* crawler, const char** uris, int uris_count, int* counts) {
+    int batch_count = (uris_count + GET_POSTS_BATCH - 1) / GET_POSTS_BATCH;
+    struct MemoryStruct* chunks = malloc(batch_count * sizeof(struct MemoryStruct));
+
+    for (int b = 0; b < batch_count; b++) {
+        int first = b * GET_POSTS_BATCH;
+        int last = first + GET_POSTS_BATCH < uris_count ? first + GET_POSTS_BATCH : uris_count;
+        char* url = posts_url(uris + first, last - first);
+
+        chunks[b] = init_MemoryStruct();
+        add_request(crawler, url, &chunks[b]); /* curl copies the url */
+        free(url);
     }
-    return 0;
+    process_completed_requests(crawler);
+
+    for (int i = 0; i < uris_count; i++) counts[i] = -1;
+
+    for (int b = 0; b < batch_count; b++) {
+        json_object* response = parse_response(&chunks[b], "get_quote_counts");
+        json_object* posts;
+        if (response == NULL) continue;
+        if (json_object_object_get_ex(response, "posts", &posts)) {
+            int array_len = json_object_array_length(posts);
+            for (int j = 0; j < array_len; j++) {
+                json_object* post = json_object_array_get_idx(posts, j);
+                const char* post_uri = json_object_get_string(json_object_object_get(post, "uri"));
+                if (post_uri == NULL) continue;
+
+                /* getPosts doesn't promise to keep order or to return every uri */
+                int first = b * GET_POSTS_BATCH;
+                int last = first + GET_POSTS_BATCH < uris_count ? first + GET_POSTS_BATCH : uris_count;
+                for (int i = first; i < last; i++) {
+                    if (strcmp(uris[i], post_uri) == 0) counts[i] = get_quote_count(post);
+                }
+            }
+        }
+        json_object_put(response);
+    }
+
+    free(chunks);
+}
+
+
+/* app.bsky.actor.getProfiles url looking up `dids_count` (at most GET_PROFILES_BATCH) actors */
+static char* profiles_url(const char* const* dids, int dids_count) {
+    size_t url_size = sizeof(API_BASE "app.bsky.actor.getProfiles?");
+    for (int i = 0; i < dids_count; i++) url_size += strlen("actors=&") + strlen(dids[i]);
+    char* url = malloc(url_size);
+
+    strcpy(url, API_BASE "app.bsky.actor.getProfiles?");
+    for (int i = 0; i < dids_count; i++) {
+        if (i > 0) strcat(url, "&");
+        strcat(url, "actors=");
+        strcat(url, dids[i]);
+    }
+    return url;
+}
+
+
+/* all batches are in flight at once, on a multi handle of their own so a running crawl
+ * doesn't get in the way. a stopped crawl doesn't abort them either */
+void get_handles(struct crawler* crawler, const char** dids, int dids_count, char** handles) {
+    int batch_count = (dids_count + GET_PROFILES_BATCH - 1) / GET_PROFILES_BATCH;
+    struct MemoryStruct* chunks = malloc((batch_count > 0 ? batch_count : 1) * sizeof(struct MemoryStruct));
+    CURLM* multi_handle = curl_multi_init();
+
+    for (int b = 0; b < batch_count; b++) {
+        int first = b * GET_PROFILES_BATCH;
+        int last = first + GET_PROFILES_BATCH < dids_count ? first + GET_PROFILES_BATCH : dids_count;
+        char* url = profiles_url(dids + first, last - first);
+
+        chunks[b] = init_MemoryStruct();
+        CURL* easy_handle = new_transfer(crawler, url, &chunks[b]);
+        curl_easy_setopt(easy_handle, CURLOPT_NOPROGRESS, 1L);
+        curl_multi_add_handle(multi_handle, easy_handle);
+        free(url);
+    }
+    run_requests(multi_handle);
+    curl_multi_cleanup(multi_handle);
+
+    for (int i = 0; i < dids_count; i++) handles[i] = NULL;
+
+    for (int b = 0; b < batch_count; b++) {
+        json_object* response = parse_response(&chunks[b], "get_handles");
+        json_object* profiles;
+        if (response == NULL) continue;
+        if (json_object_object_get_ex(response, "profiles", &profiles)) {
+            int array_len = json_object_array_length(profiles);
+            for (int j = 0; j < array_len; j++) {
+                json_object* profile = json_object_array_get_idx(profiles, j);
+                const char* did = json_object_get_string(json_object_object_get(profile, "did"));
+                const char* handle = json_object_get_string(json_object_object_get(profile, "handle"));
+
+                /* accounts whose handle stopped verifying come back as handle.invalid */
+                if (did == NULL || handle == NULL || strcmp(handle, "handle.invalid") == 0) continue;
+
+                /* getProfiles skips actors it can't find, so order tells us nothing */
+                int first = b * GET_PROFILES_BATCH;
+                int last = first + GET_PROFILES_BATCH < dids_count ? first + GET_PROFILES_BATCH : dids_count;
+                for (int i = first; i < last; i++) {
+                    if (handles[i] == NULL && strcmp(dids[i], did) == 0) handles[i] = strdup(handle);
+                }
+            }
+        }
+        json_object_put(response);
+    }
+
+    free(chunks);
+}
+
+
+void cancel_quote_search(struct crawler* crawler) {
+    atomic_store(&crawler->cancel_requested, 1);
+}
+
+
+char* get_did_from_uri(const char* uri) {
+    char* did = calloc(DID_LEN + 1, sizeof(char));
+    strncpy(did, uri + strlen(ATPROTO), DID_LEN);
+    return did;
 }
 
 
@@ -233,47 +661,1428 @@ void add_visited(const char* post_identifier, char*** visited, int* visited_coun
 }
 
 
-void recursive_quote_search(const char* actor_did, const char* post_id,
-                            char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count) {
-    char post_identifier[256];
-    snprintf(post_identifier, sizeof(post_identifier), "%s/%s", actor_did, post_id);
+/* visited-list key of an AT-URI: `did/post_id`, same as recursive_quote_search() always used.
+ * returns 0 if `uri` doesn't look like a post URI */
+static int post_key(const char* uri, char* key, size_t key_size) {
+    if (strncmp(uri, ATPROTO, strlen(ATPROTO)) != 0) return 0;
+
+    const char* did = uri + strlen(ATPROTO);
+    const char* did_end = strchr(did, '/');
+    const char* rkey = strrchr(uri, '/');
+    if (did_end == NULL || rkey == NULL) return 0;
+
+    return snprintf(key, key_size, "%.*s/%s", (int)(did_end - did), did, rkey + 1) < (int)key_size;
+}
+
+
+/*
+ * the crawl runs as a pipeline of three stages connected by bounded queues:
+ *
+ *   dispatch --fetch_queue--> network --parse_queue--> parse workers --dispatch_queue--> dispatch
+ *
+ * - network: a single thread that only moves bytes. keeps up to `max_in_flight` transfers going
+ *   on its own multi handle and hands raw bodies on.
+ * - parse workers: turn raw bodies into compact quote records. this is where the CPU goes,
+ *   so there are as many of them as we have cores to spare.
+ * - dispatch: the thread that called recursive_quote_search(). dedupes records, collects the
+ *   results, enforces budgets and turns new posts into tasks.
+ *
+ * a task is a single struct that travels the whole loop and is freed by dispatch. dispatch keeps
+ * the (unbounded, if need be on disk) frontier itself and only feeds fetch_queue as much as it
+ * takes, so the loop can't deadlock on full queues. a full parse_queue stalls the network stage instead.
+ */
+
+/* kinds of work the network stage can be handed */
+enum task_kind {
+    TASK_QUOTES, /* a getQuotes page of a post */
+    TASK_POSTS   /* a getPosts batch, revalidating quote counts of leaves or checking known posts */
+};
+
+/* the part of a post view we care about */
+struct quote_record {
+    char* uri;
+    char* author_did;
+    int quote_count; /* -1 if the view didn't carry one */
+    int like_count;  /* same */
+};
+
+struct crawl_task {
+    enum task_kind kind;
+
+    char* uri;    /* TASK_QUOTES: AT-URI of the post we want quotes of */
+    char* cursor; /* TASK_QUOTES: page cursor, NULL for the first page */
+    int depth;    /* TASK_QUOTES: distance of `uri` from the root */
+    int refresh;  /* TASK_QUOTES: the post was crawled before. stop at the first page with nothing new */
+
+    char** uris;  /* TASK_POSTS: AT-URIs to look up */
+    int* depths;  /* TASK_POSTS: distance of each of `uris` from the root */
+    int* counts;  /* TASK_POSTS: quoteCount each of `uris` had before, NULL when revalidating leaves */
+    int uris_count;
+
+    /* network -> parse */
+    char* url;                   /* of the request, while it's going */
+    struct curl_slist* headers;  /* extra request headers, while it's going */
+    struct MemoryStruct body;
+    int failed;
+
+    /* parse -> dispatch */
+    struct quote_record* records;
+    int records_count;
+    char* next_cursor;
+};
+
+struct pipeline {
+    struct crawler* crawler;
+    CURLM* multi;
+    int max_in_flight;
+    struct bqueue fetch_queue;    /* dispatch -> network */
+    struct bqueue parse_queue;    /* network -> parse workers */
+    struct bqueue dispatch_queue; /* parse workers -> dispatch */
+};
+
+/* the frontier: tasks dispatch created but didn't hand to the network stage yet. the oldest ones
+ * are kept in memory, up to `budget` bytes. newer ones spill to disk and are read back in order once
+ * the ones in memory are handed out, so a task never overtakes an older one */
+struct task_fifo {
+    struct crawl_task** items;
+    int head;
+    int count;
+    int capacity;
+    size_t bytes; /* what the tasks in memory take */
+
+    struct crawler* crawler; /* charged for the tasks in memory */
+    size_t budget;         /* 0 for no limit */
+    const char* spill_dir;
+    struct spill* spill;   /* tasks newer than the ones in memory, NULL until the budget is first hit */
+    int no_disk;           /* spilling failed once. the rest stays in memory */
+    int lost;              /* spilled tasks couldn't be read back */
+};
+
+
+static struct crawl_task* new_quotes_task(const char* uri, const char* cursor, int depth) {
+    struct crawl_task* task = calloc(1, sizeof(struct crawl_task));
+    task->kind = TASK_QUOTES;
+    task->uri = strdup(uri);
+    task->cursor = cursor ? strdup(cursor) : NULL;
+    task->depth = depth;
+    return task;
+}
+
+
+static void free_task(struct crawl_task* task) {
+    free(task->url);
+    curl_slist_free_all(task->headers);
+    free(task->uri);
+    free(task->cursor);
+    for (int i = 0; i < task->uris_count; i++) free(task->uris[i]);
+    free(task->uris);
+    free(task->depths);
+    free(task->counts);
+    free(task->body.memory);
+    for (int i = 0; i < task->records_count; i++) {
+        free(task->records[i].uri);
+        free(task->records[i].author_did);
+    }
+    free(task->records);
+    free(task->next_cursor);
+    free(task);
+}
+
+
+/* what a task on the frontier takes in memory, roughly */
+static size_t task_cost(const struct crawl_task* task) {
+    size_t cost = sizeof(struct crawl_task*) + sizeof(struct crawl_task);
+    if (task->uri) cost += strlen(task->uri) + 1;
+    if (task->cursor) cost += strlen(task->cursor) + 1;
+    for (int i = 0; i < task->uris_count; i++) {
+        cost += sizeof(char*) + strlen(task->uris[i]) + 1 + sizeof(int) + (task->counts ? sizeof(int) : 0);
+    }
+    return cost;
+}
+
+
+/* a frontier task as a spill record. only what a task has before it's handed out is kept:
+ *
+ *   Q depth refresh uri [cursor]
+ *   P count counted
+ *   depth quote_count uri         (`count` of these, quote_count is -1 unless `counted`)
+ */
+static char* write_task(const struct crawl_task* task, size_t* size) {
+    char* record = NULL;
+    FILE* stream = open_memstream(&record, size);
+    if (task->kind == TASK_QUOTES) {
+        fprintf(stream, "Q\t%d\t%d\t%s", task->depth, task->refresh, task->uri);
+        if (task->cursor) fprintf(stream, "\t%s", task->cursor);
+    } else {
+        fprintf(stream, "P\t%d\t%d", task->uris_count, task->counts != NULL);
+        for (int i = 0; i < task->uris_count; i++) {
+            fprintf(stream, "\n%d\t%d\t%s", task->depths[i], task->counts ? task->counts[i] : -1, task->uris[i]);
+        }
+    }
+    fclose(stream);
+    return record;
+}
+
+
+static struct crawl_task* read_task(char* record) {
+    char* save;
+    char* line = strtok_r(record, "\n", &save);
+    if (line == NULL) return NULL;
+
+    char* fields = NULL;
+    char* kind = strtok_r(line, "\t", &fields);
+    if (kind && strcmp(kind, "Q") == 0) {
+        char* depth = strtok_r(NULL, "\t", &fields);
+        char* refresh = strtok_r(NULL, "\t", &fields);
+        char* uri = strtok_r(NULL, "\t", &fields);
+        char* cursor = strtok_r(NULL, "\t", &fields);
+        if (uri == NULL) return NULL;
+
+        struct crawl_task* task = new_quotes_task(uri, cursor, atoi(depth));
+        task->refresh = atoi(refresh);
+        return task;
+    }
+
+    char* count = strtok_r(NULL, "\t", &fields);
+    char* counted = strtok_r(NULL, "\t", &fields);
+    if (counted == NULL) return NULL;
+
+    struct crawl_task* task = calloc(1, sizeof(struct crawl_task));
+    task->kind = TASK_POSTS;
+    int uris_count = atoi(count);
+    task->uris = malloc(uris_count * sizeof(char*));
+    task->depths = malloc(uris_count * sizeof(int));
+    if (atoi(counted)) task->counts = malloc(uris_count * sizeof(int));
+    while (task->uris_count < uris_count && (line = strtok_r(NULL, "\n", &save))) {
+        char* depth = strtok_r(line, "\t", &fields);
+        char* quote_count = strtok_r(NULL, "\t", &fields);
+        char* uri = strtok_r(NULL, "\t", &fields);
+        if (uri == NULL) break;
+
+        task->depths[task->uris_count] = atoi(depth);
+        if (task->counts) task->counts[task->uris_count] = atoi(quote_count);
+        task->uris[task->uris_count++] = strdup(uri);
+    }
+    return task;
+}
+
+
+static void task_fifo_push(struct task_fifo* fifo, struct crawl_task* task) {
+    size_t cost = task_cost(task);
+
+    /* once anything is on disk, everything newer goes there too */
+    int spilling = !fifo->no_disk && fifo->spill && spill_count(fifo->spill) > 0;
+    if (!spilling && !fifo->no_disk && fifo->budget > 0 && fifo->count > 0 && fifo->bytes + cost > fifo->budget) {
+        if (fifo->spill == NULL) fifo->spill = spill_create(fifo->spill_dir, 0);
+        spilling = 1;
+    }
+    if (spilling) {
+        size_t size;
+        char* record = write_task(task, &size);
+        int spilled = spill_push(fifo->spill, record, size);
+        free(record);
+        if (spilled) {
+            free_task(task);
+            return;
+        }
+        /* the disk let us down. holding on to it is all that's left, order be damned */
+        fifo->no_disk = 1;
+    }
+
+    if (fifo->head + fifo->count == fifo->capacity) {
+        /* slide everything back to the front before growing */
+        if (fifo->head > 0) {
+            memmove(fifo->items, fifo->items + fifo->head, fifo->count * sizeof(struct crawl_task*));
+            fifo->head = 0;
+        }
+        if (fifo->count == fifo->capacity) {
+            fifo->capacity = fifo->capacity ? fifo->capacity * 2 : 64;
+            fifo->items = realloc(fifo->items, fifo->capacity * sizeof(struct crawl_task*));
+        }
+    }
+    fifo->items[fifo->head + fifo->count++] = task;
+    fifo->bytes += cost;
+    memory_charge(fifo->crawler, MEMORY_FRONTIER, cost, 1);
+}
+
+
+static struct crawl_task* task_fifo_front(struct task_fifo* fifo) {
+    /* out of tasks in memory. read the oldest spilled ones back, as many as fit */
+    if (fifo->count == 0 && fifo->spill) {
+        fifo->head = 0;
+        while (spill_count(fifo->spill) > 0 && (fifo->count == 0 || fifo->bytes < fifo->budget)) {
+            size_t size;
+            char* record = spill_pop(fifo->spill, &size);
+            if (record == NULL) {
+                /* whatever is left there is as good as gone. say so, the results won't show it */
+                fprintf(stderr, "lost %zu spilled requests, the crawl is incomplete\n", spill_count(fifo->spill));
+                spill_free(fifo->spill);
+                fifo->spill = NULL;
+                fifo->lost = 1;
+                break;
+            }
+            struct crawl_task* task = read_task(record);
+            free(record);
+            if (task == NULL) continue;
+
+            if (fifo->count == fifo->capacity) {
+                fifo->capacity = fifo->capacity ? fifo->capacity * 2 : 64;
+                fifo->items = realloc(fifo->items, fifo->capacity * sizeof(struct crawl_task*));
+            }
+            fifo->items[fifo->count++] = task;
+            fifo->bytes += task_cost(task);
+            memory_charge(fifo->crawler, MEMORY_FRONTIER, task_cost(task), 1);
+        }
+    }
+    return fifo->count > 0 ? fifo->items[fifo->head] : NULL;
+}
+
+
+static void task_fifo_pop(struct task_fifo* fifo) {
+    size_t cost = task_cost(fifo->items[fifo->head]);
+    fifo->bytes -= cost;
+    memory_release(fifo->crawler, MEMORY_FRONTIER, cost, 1);
+    fifo->head++;
+    fifo->count--;
+}
+
+
+/* tasks on the frontier, in memory or not */
+static size_t task_fifo_size(const struct task_fifo* fifo) {
+    return fifo->count + (fifo->spill ? spill_count(fifo->spill) : 0);
+}
+
+
+/* whether the frontier took all the disk it may */
+static int task_fifo_full(const struct task_fifo* fifo, size_t spill_budget) {
+    return spill_budget > 0 && fifo->spill && spill_bytes(fifo->spill) >= spill_budget;
+}
+
+
+/* move the newest tasks in memory to disk, until the rest fit `budget` bytes. only while nothing
+ * is on disk yet: anything that is is newer still. either way, whatever comes next goes there */
+static void task_fifo_shrink(struct task_fifo* fifo, size_t budget) {
+    fifo->budget = budget;
+    if (fifo->no_disk || (fifo->spill && spill_count(fifo->spill) > 0) || fifo->bytes <= budget) return;
+
+    /* the oldest of the tasks to move is the first to go out */
+    int keep = fifo->count;
+    size_t kept = fifo->bytes;
+    while (keep > 1 && kept > budget) kept -= task_cost(fifo->items[fifo->head + --keep]);
+    if (keep == fifo->count) return;
+
+    if (fifo->spill == NULL) fifo->spill = spill_create(fifo->spill_dir, 0);
+    int moved = keep;
+    for (; moved < fifo->count; moved++) {
+        struct crawl_task* task = fifo->items[fifo->head + moved];
+        size_t size;
+        char* record = write_task(task, &size);
+        int spilled = spill_push(fifo->spill, record, size);
+        free(record);
+        if (!spilled) {
+            fifo->no_disk = 1;
+            break;
+        }
+        size_t cost = task_cost(task);
+        fifo->bytes -= cost;
+        memory_release(fifo->crawler, MEMORY_FRONTIER, cost, 1);
+        free_task(task);
+    }
+
+    /* the disk gave out halfway. what didn't make it stays, behind what did */
+    int left = fifo->count - moved;
+    memmove(fifo->items + fifo->head + keep, fifo->items + fifo->head + moved, left * sizeof(struct crawl_task*));
+    fifo->count = keep + left;
+}
+
+
+static void task_fifo_free(struct task_fifo* fifo) {
+    memory_release(fifo->crawler, MEMORY_FRONTIER, fifo->bytes, fifo->count);
+    for (int i = 0; i < fifo->count; i++) free_task(fifo->items[fifo->head + i]);
+    free(fifo->items);
+    spill_free(fifo->spill);
+    *fifo = (struct task_fifo){0};
+}
+
+
+/* request url of a task */
+static char* task_url(const struct crawl_task* task) {
+    if (task->kind == TASK_POSTS) return posts_url((const char* const*)task->uris, task->uris_count);
+
+    char* cursor = task->cursor ? curl_easy_escape(NULL, task->cursor, 0) : NULL;
+    size_t url_size = 256 + strlen(task->uri) + (cursor ? strlen(cursor) : 0);
+    char* url = malloc(url_size);
+
+    snprintf(url, url_size, API_BASE "app.bsky.feed.getQuotes?uri=%s&limit=%d%s%s",
+             task->uri, GET_QUOTES_LIMIT, cursor ? "&cursor=" : "", cursor ? cursor : "");
+    curl_free(cursor);
+    return url;
+}
+
+
+/* start fetching `task` on `multi`. a page in the page cache or a fresh copy in the response cache
+ * is used instead, in which case this returns 0 and the body is ready for parsing. a stale copy is
+ * revalidated with its ETag */
+static int start_transfer(struct crawler* crawler, CURLM* multi, struct crawl_task* task) {
+    task->url = task_url(task);
+    task->body = init_MemoryStruct();
+
+    /* getPosts is how stale counts get double checked, and a refreshed post wants its newest
+     * pages. a cached answer would defeat the point of either */
+    int cacheable = task->kind == TASK_QUOTES;
+    int reusable = cacheable && !task->refresh;
+
+    size_t size;
+    char* page = reusable && crawler->config.page_cache ? page_cache_get(crawler->config.page_cache, task->url, &size) : NULL;
+    if (page) {
+        free(task->body.memory);
+        task->body = (struct MemoryStruct){ page, size };
+        memory_charge(crawler, MEMORY_RESPONSES, size + 1, 1);
+        return 0;
+    }
+
+    struct cached_response cached;
+    if (crawler->http_cache && cacheable && http_cache_lookup(crawler->http_cache, task->url, &cached)) {
+        if (!cached.stale && reusable) {
+            if (crawler->config.page_cache) page_cache_put(crawler->config.page_cache, task->url, cached.body, cached.size);
+            free(task->body.memory);
+            task->body = (struct MemoryStruct){ cached.body, cached.size };
+            memory_charge(crawler, MEMORY_RESPONSES, cached.size + 1, 1);
+            cached.body = NULL;
+            cached_response_free(&cached);
+            return 0;
+        }
+        if (cached.etag) {
+            size_t header_size = strlen("If-None-Match: ") + strlen(cached.etag) + 1;
+            char* header = malloc(header_size);
+            snprintf(header, header_size, "If-None-Match: %s", cached.etag);
+            task->headers = curl_slist_append(NULL, header); /* curl copies the header */
+            free(header);
+        }
+        cached_response_free(&cached);
+    }
+
+    CURL* easy_handle = new_transfer(crawler, task->url, &task->body);
+    curl_easy_setopt(easy_handle, CURLOPT_PRIVATE, (void*)task);
+    if (task->headers) curl_easy_setopt(easy_handle, CURLOPT_HTTPHEADER, task->headers);
+    curl_multi_add_handle(multi, easy_handle);
+    return 1;
+}
+
+
+/* a transfer started by start_transfer() is done. a 304 gets its body from the response cache,
+ * a 200 goes into it. getQuotes pages go into the page cache either way. returns the transfer's
+ * task, marked failed if there is no usable body */
+static struct crawl_task* finish_transfer(struct crawler* crawler, CURLM* multi, CURLMsg* msg) {
+    CURL* easy_handle = msg->easy_handle;
+    CURLcode result = msg->data.result;
+    struct crawl_task* task;
+    long response_code = 0;
+    curl_easy_getinfo(easy_handle, CURLINFO_PRIVATE, (char**)&task);
+    curl_easy_getinfo(easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+
+    struct cached_response cached;
+    if (result != CURLE_OK) {
+        if (result != CURLE_ABORTED_BY_CALLBACK) {
+            fprintf(stderr, "request failed: %s\n", curl_easy_strerror(result));
+        }
+        task->failed = 1;
+    } else if (response_code == 304 && task->headers && http_cache_lookup(crawler->http_cache, task->url, &cached)) {
+        /* still what we have. nothing came over the wire but the headers */
+        http_cache_touch(crawler->http_cache, task->url);
+        free(task->body.memory);
+        task->body = (struct MemoryStruct){ cached.body, cached.size };
+        cached.body = NULL;
+        cached_response_free(&cached);
+    } else if (response_code != 200) {
+        fprintf(stderr, "cURL request failed! response - %ld\nRAW: %s\n", response_code, task->body.memory);
+        task->failed = 1;
+    } else if (crawler->http_cache && task->kind == TASK_QUOTES) {
+        struct curl_header* etag = NULL;
+        curl_easy_header(easy_handle, "ETag", 0, CURLH_HEADER, -1, &etag);
+        http_cache_store(crawler->http_cache, task->url, etag ? etag->value : NULL, task->body.memory, task->body.size);
+    }
+
+    if (!task->failed && task->kind == TASK_QUOTES && crawler->config.page_cache) {
+        page_cache_put(crawler->config.page_cache, task->url, task->body.memory, task->body.size);
+    }
+    if (!task->failed) memory_charge(crawler, MEMORY_RESPONSES, task->body.size + 1, 1);
+
+    curl_multi_remove_handle(multi, easy_handle);
+    curl_easy_cleanup(easy_handle);
+    curl_slist_free_all(task->headers);
+    task->headers = NULL;
+    free(task->url);
+    task->url = NULL;
+    return task;
+}
+
+
+/* network stage. runs until fetch_queue is closed and every transfer finished */
+static void* network_stage(void* arg) {
+    struct pipeline* p = arg;
+    int in_flight = 0;
+    int input_closed = 0;
+
+    while (!input_closed || in_flight > 0) {
+        /* top up the transfers. only block waiting for work when there is nothing else to wait on */
+        while (!input_closed && in_flight < p->max_in_flight) {
+            struct crawl_task* task = in_flight == 0 ? bqueue_pop(&p->fetch_queue) : bqueue_try_pop(&p->fetch_queue);
+            if (task == NULL) {
+                if (in_flight == 0) input_closed = 1;
+                break;
+            }
+
+            /* the crawl is stopping. don't start anything new, just hand the task back */
+            if (crawl_expired(p->crawler)) {
+                task->failed = 1;
+                bqueue_push(&p->parse_queue, task);
+                continue;
+            }
+
+            if (!start_transfer(p->crawler, p->multi, task)) {
+                bqueue_push(&p->parse_queue, task);
+                continue;
+            }
+            in_flight++;
+        }
+        if (in_flight == 0) continue;
+
+        int still_running = 0;
+        curl_multi_perform(p->multi, &still_running);
+
+        CURLMsg *msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read(p->multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            struct crawl_task* task = finish_transfer(p->crawler, p->multi, msg);
+            in_flight--;
 
-    if (is_visited(post_identifier, *visited, *visited_count)) return;
-    add_visited(post_identifier, visited, visited_count);
+            /* blocks while the parse workers are behind, which is exactly the backpressure we want */
+            bqueue_push(&p->parse_queue, task);
+        }
+
+        if (in_flight > 0) curl_multi_poll(p->multi, NULL, 0, 100, NULL);
+    }
+
+    bqueue_close(&p->parse_queue);
+    return NULL;
+}
+
+
+/* turn the raw body of a task into records. the body is freed either way */
+static void parse_task(struct crawler* crawler, struct crawl_task* task) {
+    size_t tree_cost = task->body.size * JSON_TREE_COST;
+    json_object* response = json_tokener_parse(task->body.memory);
+    if (response) memory_charge(crawler, MEMORY_JSON, tree_cost, 1);
+    memory_release(crawler, MEMORY_RESPONSES, task->body.size + 1, 1);
+    free(task->body.memory);
+    task->body = (struct MemoryStruct){0};
 
-    json_object* quotes = get_quotes(actor_did, post_id);
-    if (quotes == NULL) return;
+    if (response == NULL) {
+        fprintf(stderr, "failed to parse JSON response from %s\n", task->kind == TASK_QUOTES ? "getQuotes" : "getPosts");
+        task->failed = 1;
+        return;
+    }
 
     json_object* posts;
-    if (json_object_object_get_ex(quotes, "posts", &posts)) {
+    if (json_object_object_get_ex(response, "posts", &posts)) {
         int array_len = json_object_array_length(posts);
+        task->records = calloc(array_len > 0 ? array_len : 1, sizeof(struct quote_record));
+
         for (int i = 0; i < array_len; i++) {
             json_object* post = json_object_array_get_idx(posts, i);
             const char* post_uri = json_object_get_string(json_object_object_get(post, "uri"));
-            (*all_quotes) = realloc(*all_quotes, (*all_quotes_count + 1) * sizeof(char*));
-            (*all_quotes)[*all_quotes_count] = strdup(post_uri);
-            (*all_quotes_count)++;
+            const char* author_did = json_object_get_string(json_object_object_get(json_object_object_get(post, "author"), "did"));
+            if (post_uri == NULL) continue;
 
-            signal_main_thread();
+            struct quote_record* record = &task->records[task->records_count++];
+            record->uri = strdup(post_uri);
+            record->author_did = author_did ? strdup(author_did) : NULL;
+            record->quote_count = get_quote_count(post);
 
-            const char* quoted_actor_did = json_object_get_string(json_object_object_get(json_object_object_get(post, "author"), "did"));
-            char* quoted_post_id = extract_post_id(post_uri);
-            recursive_quote_search(quoted_actor_did, quoted_post_id, visited, visited_count, all_quotes, all_quotes_count);
-            free(quoted_post_id);
+            json_object* likes;
+            record->like_count = json_object_object_get_ex(post, "likeCount", &likes) ? json_object_get_int(likes) : -1;
         }
     }
 
-    json_object_put(quotes);
+    json_object* cursor;
+    if (json_object_object_get_ex(response, "cursor", &cursor) && json_object_get_string(cursor) != NULL) {
+        task->next_cursor = strdup(json_object_get_string(cursor));
+    }
+
+    json_object_put(response);
+    memory_release(crawler, MEMORY_JSON, tree_cost, 1);
 }
 
 
-/* get DID from given AT-URI. example:
- * input: "at://did:plc:ybflevxvh5zylcoxbohxu224/app.bsky.feed.post/3l7det4aqy52h";
- * output: "did:plc:ybflevxvh5zylcoxbohxu224" */
-char* get_did_from_uri(const char* uri) {
-    char* did = calloc(DID_LEN, sizeof(char));
-    strncpy(did, uri + strlen(ATPROTO), DID_LEN);
-    return did;
+/* parse worker. runs until parse_queue is closed and drained */
+static void* parse_stage(void* arg) {
+    struct pipeline* p = arg;
+    struct crawl_task* task;
+
+    while ((task = bqueue_pop(&p->parse_queue))) {
+        if (!task->failed) parse_task(p->crawler, task);
+        bqueue_push(&p->dispatch_queue, task);
+    }
+    return NULL;
+}
+
+
+/* bookkeeping of a single recursive_quote_search(). only touched by the dispatch stage */
+struct crawl_state {
+    struct crawler* crawler;
+
+    int requests;  /* requests issued so far */
+    int truncated; /* a budget stopped us before the cascade was exhausted */
+    int stopped;   /* a budget, the deadline or cancellation hit. don't start anything new */
+
+    struct strset expanded;  /* keys of posts we asked quotes for */
+    struct strset collected; /* uris of quotes we collected */
+    struct task_fifo frontier;
+
+    /* leaves waiting for a getPosts batch to revalidate their quote count */
+    char** leaves;
+    int* leaf_depths;
+    int leaves_count;
+
+    /* journal of the crawl, NULL if it isn't checkpointed */
+    struct checkpoint* checkpoint;
+
+    int quotes_count;   /* quotes collected so far, including whatever the caller's array held */
+    int initial_quotes; /* what the caller's array held */
+
+    /* past the memory budget: how many steps were taken to get back under it, and when the last one
+     * was taken or undone */
+    int memory_steps;
+    double memory_stepped_at;
+    int page_cache_trimmed;
+    int concurrency;            /* requests the crawl keeps in flight when left alone */
+    atomic_int in_flight_limit; /* what it may keep in flight now, 0 for no limit of its own */
+
+    /* the caller's arrays. either pair may be NULL */
+    char*** visited;
+    int* visited_count;
+    char*** all_quotes;
+    int* all_quotes_count;
+};
+
+
+/* stop issuing work and abort whatever is in flight */
+static void stop_crawl(struct crawl_state* state) {
+    state->truncated = 1;
+    state->stopped = 1;
+    atomic_store(&state->crawler->stopping, 1);
+}
+
+
+/* whether we may spend `cost` more requests. stops the crawl otherwise.
+ * requests already in flight were paid for, so running out of budget lets them finish */
+static int spend_requests(struct crawl_state* state, int cost) {
+    const struct crawl_limits* limits = &state->crawler->config.limits;
+    if (state->stopped) return 0;
+    if (crawl_expired(state->crawler)) {
+        stop_crawl(state);
+        return 0;
+    }
+    if (limits->max_requests > 0 && state->requests + cost > limits->max_requests) {
+        state->truncated = 1;
+        state->stopped = 1;
+        return 0;
+    }
+    /* every request adds to the frontier. with no room left for it, the crawl has to stop growing */
+    if (task_fifo_full(&state->frontier, state->crawler->config.spill_budget)) {
+        state->truncated = 1;
+        state->stopped = 1;
+        return 0;
+    }
+    state->requests += cost;
+    return 1;
+}
+
+
+/* whether a post at `depth` may be expanded. marks the crawl truncated otherwise */
+static int may_expand(struct crawl_state* state, int depth) {
+    const struct crawl_limits* limits = &state->crawler->config.limits;
+    if (limits->max_depth > 0 && depth >= limits->max_depth) {
+        state->truncated = 1;
+        return 0;
+    }
+    return !state->stopped;
+}
+
+
+/* add `key` to one of the dedupe sets, charging whatever it takes */
+static int remember(struct crawl_state* state, struct strset* set, const char* key) {
+    size_t capacity = set->capacity;
+    if (!strset_insert(set, key)) return 0;
+
+    memory_charge(state->crawler, MEMORY_DEDUPE, strlen(key) + 1, 1);
+    if (set->capacity != capacity) {
+        /* the table grew: a new one came, the old one went */
+        memory_charge(state->crawler, MEMORY_DEDUPE, set->capacity * sizeof(char*), 1);
+        memory_release(state->crawler, MEMORY_DEDUPE, capacity * sizeof(char*), 1);
+    }
+    return 1;
+}
+
+
+/* hand the key of an expanded post to the caller's visited array, if there is one */
+static void add_visited_key(struct crawl_state* state, const char* key) {
+    if (state->visited == NULL) return;
+    add_visited(key, state->visited, state->visited_count);
+    memory_charge(state->crawler, MEMORY_RESULTS, sizeof(char*) + strlen(key) + 1, 1);
+}
+
+
+/* hand a collected quote to the caller's all_quotes array, if there is one */
+static void add_quote(struct crawl_state* state, const char* uri) {
+    if (state->all_quotes == NULL) return;
+    (*state->all_quotes) = realloc(*state->all_quotes, (*state->all_quotes_count + 1) * sizeof(char*));
+    (*state->all_quotes)[*state->all_quotes_count] = strdup(uri);
+    (*state->all_quotes_count)++;
+    memory_charge(state->crawler, MEMORY_RESULTS, sizeof(char*) + strlen(uri) + 1, 1);
+}
+
+
+/* queue up the first getQuotes page of `uri`, unless we already did */
+static void expand_post(struct crawl_state* state, const char* uri, int depth) {
+    char key[256];
+    if (!post_key(uri, key, sizeof(key))) return;
+    if (!remember(state, &state->expanded, key)) return;
+
+    add_visited_key(state, key);
+    if (state->checkpoint) checkpoint_expanded(state->checkpoint, uri, depth);
+    task_fifo_push(&state->frontier, new_quotes_task(uri, NULL, depth));
+}
+
+
+/* a post that was crawled before has new quotes. fetch its pages again, newest first, until they
+ * stop turning up anything new */
+static void refresh_post(struct crawl_state* state, const char* uri, int depth) {
+    char key[256];
+    if (!post_key(uri, key, sizeof(key)) || !may_expand(state, depth)) return;
+
+    if (remember(state, &state->expanded, key)) add_visited_key(state, key);
+    if (state->checkpoint) checkpoint_expanded(state->checkpoint, uri, depth);
+
+    struct crawl_task* task = new_quotes_task(uri, NULL, depth);
+    task->refresh = 1;
+    task_fifo_push(&state->frontier, task);
+}
+
+
+/* turn pending leaves into a getPosts task on the frontier */
+static void flush_leaves(struct crawl_state* state) {
+    if (state->leaves_count == 0) return;
+
+    struct crawl_task* task = calloc(1, sizeof(struct crawl_task));
+    task->kind = TASK_POSTS;
+    task->uris = state->leaves;
+    task->depths = state->leaf_depths;
+    task->uris_count = state->leaves_count;
+    task_fifo_push(&state->frontier, task);
+
+    state->leaves = NULL;
+    state->leaf_depths = NULL;
+    state->leaves_count = 0;
+}
+
+
+/* remember a quote whose view claims it has no quotes, to double check it later */
+static void add_leaf(struct crawl_state* state, const char* uri, int depth) {
+    state->leaves = realloc(state->leaves, (state->leaves_count + 1) * sizeof(char*));
+    state->leaf_depths = realloc(state->leaf_depths, (state->leaves_count + 1) * sizeof(int));
+    state->leaves[state->leaves_count] = strdup(uri);
+    state->leaf_depths[state->leaves_count] = depth;
+    state->leaves_count++;
+
+    if (state->leaves_count == GET_POSTS_BATCH) flush_leaves(state);
+}
+
+
+/* dispatch stage: fold a finished task into the results and the frontier */
+static void dispatch_task(struct crawl_state* state, struct crawl_task* task) {
+    const struct crawler_config* config = &state->crawler->config;
+
+    if (task->failed) {
+        /* an aborted transfer leaves nothing behind, make sure it's accounted for */
+        if (crawl_expired(state->crawler)) stop_crawl(state);
+        return;
+    }
+
+    if (task->kind == TASK_POSTS && task->counts) {
+        /* an incremental crawl checking on known posts. only the ones that gained quotes get crawled */
+        for (int i = 0; i < task->records_count && !state->stopped; i++) {
+            const struct quote_record* record = &task->records[i];
+            for (int j = 0; j < task->uris_count; j++) {
+                if (strcmp(task->uris[j], record->uri) != 0) continue;
+                if (record->quote_count >= 0 && record->quote_count != task->counts[j] && state->checkpoint) {
+                    checkpoint_count(state->checkpoint, record->uri, record->quote_count);
+                }
+                if (record->quote_count > task->counts[j]) refresh_post(state, record->uri, task->depths[j]);
+                break;
+            }
+        }
+        return;
+    }
+
+    if (task->kind == TASK_POSTS) {
+        for (int j = 0; j < task->uris_count && state->checkpoint; j++) checkpoint_revalidated(state->checkpoint, task->uris[j]);
+
+        /* counts in a page may be stale (it could be cached by the appview).
+         * expand whatever turned out to have quotes after all */
+        for (int i = 0; i < task->records_count && !state->stopped; i++) {
+            if (task->records[i].quote_count == 0) continue;
+            for (int j = 0; j < task->uris_count; j++) {
+                if (strcmp(task->uris[j], task->records[i].uri) != 0) continue;
+                expand_post(state, task->uris[j], task->depths[j]);
+                break;
+            }
+        }
+        return;
+    }
+
+    /* a stopped crawl still collects what comes back, it just doesn't expand it */
+    int page_done = 1;
+    int added = 0;
+    for (int i = 0; i < task->records_count; i++) {
+        struct quote_record* record = &task->records[i];
+
+        struct quote_edge edge = { .parent_uri = task->uri, .child_uri = record->uri, .depth = task->depth + 1 };
+        for (int n = 0; n < config->sinks_count; n++) {
+            if (config->sinks[n].on_edge) config->sinks[n].on_edge(config->sinks[n].userdata, &edge);
+        }
+
+        if (strset_contains(&state->collected, record->uri)) continue;
+
+        if (config->limits.max_nodes > 0 && state->quotes_count >= config->limits.max_nodes) {
+            stop_crawl(state);
+            page_done = 0;
+            break;
+        }
+
+        remember(state, &state->collected, record->uri);
+        state->quotes_count++;
+        added++;
+        add_quote(state, record->uri);
+
+        struct quote_result result = {
+            .uri = record->uri,
+            .parent_uri = task->uri,
+            .author_did = record->author_did,
+            .depth = task->depth + 1,
+            .quote_count = record->quote_count,
+            .like_count = record->like_count
+        };
+        if (state->checkpoint) checkpoint_quote(state->checkpoint, &result);
+        for (int n = 0; n < config->sinks_count; n++) {
+            if (config->sinks[n].on_result) config->sinks[n].on_result(config->sinks[n].userdata, &result);
+        }
+
+        /* the hydrated view already tells us there is nothing to expand. skip the request */
+        if (record->quote_count == 0) {
+            int leaf_expandable = config->limits.max_depth <= 0 || task->depth + 1 < config->limits.max_depth;
+            if (config->revalidate_leaves && leaf_expandable && !state->stopped) add_leaf(state, record->uri, task->depth + 1);
+            continue;
+        }
+        if (!may_expand(state, task->depth + 1)) continue;
+
+        expand_post(state, record->uri, task->depth + 1);
+    }
+
+    /* the post has more quotes than fit a page. pages come newest first, so a refreshed post
+     * is caught up as soon as a page has nothing new */
+    int more = task->next_cursor && task->records_count > 0 && !(task->refresh && added == 0);
+    if (page_done && state->checkpoint) checkpoint_page(state->checkpoint, task->uri, more ? task->next_cursor : NULL);
+    if (more && !state->stopped) {
+        struct crawl_task* next = new_quotes_task(task->uri, task->next_cursor, task->depth);
+        next->refresh = task->refresh;
+        task_fifo_push(&state->frontier, next);
+    }
+}
+
+
+/* pick up where a checkpointed crawl left off. its quotes go to the sinks and the caller's arrays
+ * like freshly found ones, unless the crawl is incremental and only wants what's new. unfinished
+ * posts go back on the frontier, and quotes that were never expanded or revalidated get the
+ * treatment dispatch_task() would have given them */
+static void restore_crawl(struct crawl_state* state, const struct checkpoint_restore* restore) {
+    const struct crawler_config* config = &state->crawler->config;
+
+    for (int i = 0; i < restore->expanded_count; i++) {
+        char key[256];
+        if (!post_key(restore->expanded[i], key, sizeof(key)) || !remember(state, &state->expanded, key)) continue;
+        add_visited_key(state, key);
+    }
+    for (int i = 0; i < restore->open_count; i++) {
+        const struct restored_post* post = &restore->open[i];
+        task_fifo_push(&state->frontier, new_quotes_task(post->uri, post->cursor, post->depth));
+    }
+    for (int i = 0; i < restore->quotes_count; i++) {
+        const struct restored_quote* quote = &restore->quotes[i];
+        if (!remember(state, &state->collected, quote->uri)) continue;
+
+        if (config->incremental) {
+            if (quote->quote_count != 0 && may_expand(state, quote->depth)) expand_post(state, quote->uri, quote->depth);
+            continue;
+        }
+
+        state->quotes_count++;
+        add_quote(state, quote->uri);
+
+        struct quote_edge edge = { .parent_uri = quote->parent_uri, .child_uri = quote->uri, .depth = quote->depth };
+        struct quote_result result = {
+            .uri = quote->uri,
+            .parent_uri = quote->parent_uri,
+            .author_did = quote->author_did,
+            .depth = quote->depth,
+            .quote_count = quote->quote_count,
+            .like_count = quote->like_count
+        };
+        for (int n = 0; n < config->sinks_count; n++) {
+            if (config->sinks[n].on_edge) config->sinks[n].on_edge(config->sinks[n].userdata, &edge);
+            if (config->sinks[n].on_result) config->sinks[n].on_result(config->sinks[n].userdata, &result);
+        }
+
+        if (quote->quote_count != 0 && may_expand(state, quote->depth)) expand_post(state, quote->uri, quote->depth);
+    }
+
+    /* incremental crawls check every leaf anyway */
+    for (int i = 0; config->revalidate_leaves && !config->incremental && i < restore->leaves_count; i++) {
+        const struct restored_post* leaf = &restore->leaves[i];
+        if (config->limits.max_depth <= 0 || leaf->depth < config->limits.max_depth) add_leaf(state, leaf->uri, leaf->depth);
+    }
+}
+
+
+/* queue up getPosts batches checking the quoteCount of every post a checkpoint knows. posts whose
+ * count was never seen are compared against the quotes of them that were collected */
+static void check_known_posts(struct crawl_state* state, const struct checkpoint_restore* restore) {
+    for (int first = 0; first < restore->nodes_count; first += GET_POSTS_BATCH) {
+        int count = restore->nodes_count - first < GET_POSTS_BATCH ? restore->nodes_count - first : GET_POSTS_BATCH;
+
+        struct crawl_task* task = calloc(1, sizeof(struct crawl_task));
+        task->kind = TASK_POSTS;
+        task->uris = malloc(count * sizeof(char*));
+        task->depths = malloc(count * sizeof(int));
+        task->counts = malloc(count * sizeof(int));
+        task->uris_count = count;
+        for (int i = 0; i < count; i++) {
+            const struct restored_node* node = &restore->nodes[first + i];
+            task->uris[i] = strdup(node->uri);
+            task->depths[i] = node->depth;
+            task->counts[i] = node->quote_count >= 0 ? node->quote_count : node->children;
+        }
+        task_fifo_push(&state->frontier, task);
+    }
+}
+
+
+/* number of parse workers to run when nobody said otherwise. one core goes to the network stage */
+static int default_parse_workers(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores <= 2) return 1;
+    return cores - 1 > MAX_DEFAULT_PARSE_WORKERS ? MAX_DEFAULT_PARSE_WORKERS : cores - 1;
+}
+
+
+/* back well under the memory budget. undo the last step that cut the frontier and concurrency */
+static void restore_memory(struct crawl_state* state, double now) {
+    const struct crawler_config* config = &state->crawler->config;
+    if (state->memory_steps == 0) return;
+    state->memory_stepped_at = now;
+
+    int limit = atomic_load(&state->in_flight_limit);
+    if (limit > 0) atomic_store(&state->in_flight_limit, limit * 2 >= state->concurrency ? 0 : limit * 2);
+
+    /* without a frontier budget of its own, the frontier gets back to none once it's allowed the whole budget */
+    size_t configured = config->frontier_memory;
+    size_t ceiling = configured > 0 ? configured : config->memory_budget;
+    if (state->frontier.budget != configured) {
+        state->frontier.budget = state->frontier.budget * 2 >= ceiling ? configured : state->frontier.budget * 2;
+    }
+
+    if (atomic_load(&state->in_flight_limit) == 0 && state->frontier.budget == configured) {
+        state->memory_steps = 0;
+        state->page_cache_trimmed = 0;
+    }
+}
+
+
+/* keep what the crawl could do without around its memory budget. over it, take the next step
+ * toward getting back under, under half of it, undo one. at most one either way every
+ * MEMORY_STEP_INTERVAL. called by dispatch */
+static void shed_memory(struct crawl_state* state) {
+    struct crawler* crawler = state->crawler;
+    size_t budget = crawler->config.memory_budget;
+    if (budget == 0) return;
+
+    double now = monotonic_now();
+    if (now - state->memory_stepped_at < MEMORY_STEP_INTERVAL) return;
+
+    size_t live = memory_sheddable(crawler);
+    if (live <= budget) {
+        if (live < budget / 2) restore_memory(state, now);
+        return;
+    }
+
+    /* pages other crawls may want are the cheapest to lose. they aren't ours to count, but they
+     * take memory all the same. only a step if there was something to drop */
+    if (!state->page_cache_trimmed && crawler->config.page_cache) {
+        state->page_cache_trimmed = 1;
+        size_t cached = page_cache_get_stats(crawler->config.page_cache).bytes;
+        page_cache_trim(crawler->config.page_cache, 0);
+        if (cached > 0) {
+            state->memory_stepped_at = now;
+            return;
+        }
+    }
+
+    /* then the requests we have yet to make, which can wait on disk */
+    int stepped = 0;
+    size_t frontier_budget = state->frontier.budget;
+    if (frontier_budget == 0 || frontier_budget > MIN_FRONTIER_MEMORY) {
+        size_t held = frontier_budget > 0 && frontier_budget < state->frontier.bytes ? frontier_budget : state->frontier.bytes;
+        task_fifo_shrink(&state->frontier, held / 2 > MIN_FRONTIER_MEMORY ? held / 2 : MIN_FRONTIER_MEMORY);
+        stepped = 1;
+    }
+
+    /* then, from the second step on, fewer responses at once, which is fewer bodies and trees in memory */
+    int limit = atomic_load(&state->in_flight_limit);
+    if (limit == 0) limit = state->concurrency;
+    if ((state->memory_steps > 0 || !stepped) && limit > 1) {
+        atomic_store(&state->in_flight_limit, limit / 2);
+        stepped = 1;
+    }
+
+    /* at the floor of both, there's nothing left to give */
+    if (stepped) {
+        state->memory_steps++;
+        state->memory_stepped_at = now;
+    }
+}
+
+
+/* set up the bookkeeping of a crawl that appends to the caller's arrays, and start its clock */
+static void begin_crawl(struct crawl_state* state, struct crawler* crawler, char*** visited, int* visited_count,
+                        char*** all_quotes, int* all_quotes_count) {
+    *state = (struct crawl_state){
+        .crawler = crawler,
+        .visited = visited,
+        .visited_count = visited_count,
+        .all_quotes = all_quotes,
+        .all_quotes_count = all_quotes_count
+    };
+    for (int i = 0; i < MEMORY_SUBSYSTEMS; i++) {
+        atomic_store(&crawler->memory[i].live, 0);
+        atomic_store(&crawler->memory[i].peak, 0);
+        atomic_store(&crawler->memory[i].allocations, 0);
+        atomic_store(&crawler->memory[i].frees, 0);
+    }
+    strset_init(&state->expanded);
+    strset_init(&state->collected);
+    memory_charge(crawler, MEMORY_DEDUPE, (state->expanded.capacity + state->collected.capacity) * sizeof(char*), 2);
+    state->frontier.crawler = crawler;
+    state->frontier.budget = crawler->config.frontier_memory;
+    state->frontier.spill_dir = crawler->config.spill_dir;
+    if (visited) {
+        for (int i = 0; i < *visited_count; i++) remember(state, &state->expanded, (*visited)[i]);
+    }
+    if (all_quotes) {
+        for (int i = 0; i < *all_quotes_count; i++) remember(state, &state->collected, (*all_quotes)[i]);
+        state->quotes_count = state->initial_quotes = *all_quotes_count;
+    }
+
+    if (crawler->config.checkpoint_path) {
+        struct checkpoint_restore restore;
+        state->checkpoint = checkpoint_open(crawler->config.checkpoint_path, crawler->config.checkpoint_interval,
+                                            crawler->config.resume || crawler->config.incremental, &restore);
+        if (state->checkpoint) restore_crawl(state, &restore);
+        if (state->checkpoint && crawler->config.incremental) check_known_posts(state, &restore);
+        checkpoint_restore_free(&restore);
+    }
+
+    double deadline_seconds = crawler->config.limits.deadline_seconds;
+    atomic_store(&crawler->cancel_requested, 0);
+    atomic_store(&crawler->stopping, 0);
+    crawler->deadline = deadline_seconds > 0 ? monotonic_now() + deadline_seconds : 0;
+}
+
+
+/* tell the sinks we're done and free whatever the crawl left behind. returns whether it was truncated */
+static int end_crawl(struct crawl_state* state) {
+    const struct crawler_config* config = &state->crawler->config;
+    if (state->frontier.lost) state->truncated = 1;
+    struct crawl_summary summary = {
+        .quotes = state->quotes_count - state->initial_quotes,
+        .requests = state->requests,
+        .truncated = state->truncated
+    };
+    for (int n = 0; n < config->sinks_count; n++) {
+        if (config->sinks[n].on_complete) config->sinks[n].on_complete(config->sinks[n].userdata, &summary);
+    }
+
+    task_fifo_free(&state->frontier);
+    for (int i = 0; i < state->leaves_count; i++) free(state->leaves[i]);
+    free(state->leaves);
+    free(state->leaf_depths);
+    memory_release(state->crawler, MEMORY_DEDUPE, atomic_load(&state->crawler->memory[MEMORY_DEDUPE].live),
+                   state->expanded.count + state->collected.count + 2);
+    strset_free(&state->expanded);
+    strset_free(&state->collected);
+    checkpoint_close(state->checkpoint);
+
+    state->crawler->deadline = 0;
+    atomic_store(&state->crawler->stopping, 0);
+    return state->truncated;
+}
+
+
+int recursive_quote_search(struct crawler* crawler, const char* actor_did, const char* post_id,
+                           char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count) {
+    const struct crawler_config* config = &crawler->config;
+    struct crawl_state state;
+    begin_crawl(&state, crawler, visited, visited_count, all_quotes, all_quotes_count);
+
+    struct pipeline p = {
+        .crawler = crawler,
+        .multi = curl_multi_init(),
+        .max_in_flight = config->max_in_flight > 0 ? config->max_in_flight : DEFAULT_MAX_IN_FLIGHT
+    };
+    int workers_count = config->parse_workers > 0 ? config->parse_workers : default_parse_workers();
+    bqueue_init(&p.fetch_queue, p.max_in_flight * 2);
+    bqueue_init(&p.parse_queue, p.max_in_flight * 2);
+    bqueue_init(&p.dispatch_queue, p.max_in_flight * 2);
+
+    pthread_t network_thread;
+    pthread_t* worker_threads = malloc(workers_count * sizeof(pthread_t));
+    pthread_create(&network_thread, NULL, network_stage, &p);
+    for (int i = 0; i < workers_count; i++) pthread_create(&worker_threads[i], NULL, parse_stage, &p);
+
+    char root_uri[256];
+    snprintf(root_uri, sizeof(root_uri), ATPROTO "%s/app.bsky.feed.post/%s", actor_did, post_id);
+    expand_post(&state, root_uri, 0);
+
+    state.concurrency = p.max_in_flight;
+    int outstanding = 0; /* tasks handed to the network stage that didn't come back yet */
+    for (;;) {
+        int handed = 0;
+        int limit = atomic_load(&state.in_flight_limit);
+        struct crawl_task* task;
+        while ((limit == 0 || outstanding < limit) && (task = task_fifo_front(&state.frontier)) && spend_requests(&state, 1)) {
+            if (!bqueue_try_push(&p.fetch_queue, task)) {
+                state.requests--;
+                break;
+            }
+            task_fifo_pop(&state.frontier);
+            outstanding++;
+            handed = 1;
+        }
+        if (handed) curl_multi_wakeup(p.multi);
+
+        if (outstanding == 0) {
+            /* the cascade ran dry. leaves still waiting for revalidation are the last thing to do */
+            if (!state.stopped && task_fifo_size(&state.frontier) == 0 && state.leaves_count > 0) {
+                flush_leaves(&state);
+                continue;
+            }
+            if (state.stopped || task_fifo_size(&state.frontier) == 0) break;
+        }
+
+        task = bqueue_pop(&p.dispatch_queue);
+        outstanding--;
+        dispatch_task(&state, task);
+        free_task(task);
+        shed_memory(&state);
+    }
+
+    /* everything came back, so closing fetch_queue winds down the whole pipeline */
+    bqueue_close(&p.fetch_queue);
+    pthread_join(network_thread, NULL);
+    for (int i = 0; i < workers_count; i++) pthread_join(worker_threads[i], NULL);
+    free(worker_threads);
+
+    bqueue_destroy(&p.fetch_queue);
+    bqueue_destroy(&p.parse_queue);
+    bqueue_destroy(&p.dispatch_queue);
+    curl_multi_cleanup(p.multi);
+
+    return end_crawl(&state);
+}
+
+
+/*
+ * worker mode, for crawling many roots at once. every worker thread runs its own multi handle
+ * and parses its own responses, so nothing funnels through a single network thread:
+ *
+ * - each worker keeps a local deque of tasks. it works LIFO off the bottom (depth first, which
+ *   keeps the deque short), idle workers steal FIFO off the top of somebody else's (the oldest
+ *   tasks, which tend to be the biggest subtrees).
+ * - dedupe, results and budgets are shared through one crawl_state behind `state_mutex`.
+ *   only dispatch_task() runs under it, the expensive parsing doesn't.
+ * - `pending` counts tasks that exist anywhere. the crawl is done when it drops to 0.
+ */
+
+/* a worker's own frontier. items[top, bottom) are live */
+struct work_deque {
+    pthread_mutex_t mutex;
+    struct crawl_task** items;
+    int top;
+    int bottom;
+    int capacity;
+};
+
+struct worker_pool;
+
+struct crawl_worker {
+    struct worker_pool* pool;
+    pthread_t thread;
+    CURLM* multi;
+    struct work_deque deque;
+    unsigned int steal_seed;
+};
+
+struct worker_pool {
+    struct crawl_worker* workers;
+    int workers_count;
+    int max_in_flight; /* per worker */
+
+    pthread_mutex_t state_mutex;
+    struct crawl_state state;
+
+    atomic_int pending;
+
+    /* idle workers sleep here until somebody has work to steal */
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t work_available;
+};
+
+
+static void deque_push_bottom(struct work_deque* deque, struct crawl_task* task) {
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->bottom == deque->capacity) {
+        int count = deque->bottom - deque->top;
+        if (deque->top > 0) {
+            memmove(deque->items, deque->items + deque->top, count * sizeof(struct crawl_task*));
+        }
+        deque->top = 0;
+        deque->bottom = count;
+        if (count == deque->capacity) {
+            deque->capacity = deque->capacity ? deque->capacity * 2 : 64;
+            deque->items = realloc(deque->items, deque->capacity * sizeof(struct crawl_task*));
+        }
+    }
+    deque->items[deque->bottom++] = task;
+    pthread_mutex_unlock(&deque->mutex);
+}
+
+
+static struct crawl_task* deque_pop_bottom(struct work_deque* deque) {
+    pthread_mutex_lock(&deque->mutex);
+    struct crawl_task* task = deque->bottom > deque->top ? deque->items[--deque->bottom] : NULL;
+    pthread_mutex_unlock(&deque->mutex);
+    return task;
+}
+
+
+static struct crawl_task* deque_steal_top(struct work_deque* deque) {
+    pthread_mutex_lock(&deque->mutex);
+    struct crawl_task* task = deque->bottom > deque->top ? deque->items[deque->top++] : NULL;
+    pthread_mutex_unlock(&deque->mutex);
+    return task;
+}
+
+
+/* take a task from some other worker, starting at a random victim */
+static struct crawl_task* steal_task(struct crawl_worker* self) {
+    struct worker_pool* pool = self->pool;
+    int start = rand_r(&self->steal_seed) % pool->workers_count;
+
+    for (int i = 0; i < pool->workers_count; i++) {
+        struct crawl_worker* victim = &pool->workers[(start + i) % pool->workers_count];
+        if (victim == self) continue;
+
+        struct crawl_task* task = deque_steal_top(&victim->deque);
+        if (task) return task;
+    }
+    return NULL;
+}
+
+
+/* move whatever dispatch_task() put on the shared frontier onto our own deque. with a memory
+ * budget on the frontier, only about as much as we can keep in flight: the rest stays where it
+ * may spill, and gets picked up as we run dry. caller holds state_mutex */
+static int adopt_frontier(struct crawl_worker* self) {
+    struct crawl_state* state = &self->pool->state;
+    int limit = state->frontier.budget > 0 ? self->pool->max_in_flight * 2 : -1;
+    int adopted = 0;
+
+    struct crawl_task* task;
+    while (adopted != limit && (task = task_fifo_front(&state->frontier))) {
+        task_fifo_pop(&state->frontier);
+        deque_push_bottom(&self->deque, task);
+        adopted++;
+    }
+    atomic_fetch_add(&self->pool->pending, adopted);
+    return adopted;
+}
+
+
+static void wake_idle_workers(struct worker_pool* pool) {
+    pthread_mutex_lock(&pool->idle_mutex);
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->idle_mutex);
+}
+
+
+/* a task is done one way or another. fold it in and forget about it */
+static void finish_task(struct crawl_worker* self, struct crawl_task* task) {
+    struct worker_pool* pool = self->pool;
+
+    if (!task->failed) parse_task(pool->state.crawler, task);
+
+    pthread_mutex_lock(&pool->state_mutex);
+    dispatch_task(&pool->state, task);
+    shed_memory(&pool->state);
+    int adopted = adopt_frontier(self);
+    pthread_mutex_unlock(&pool->state_mutex);
+
+    free_task(task);
+
+    /* new work is accounted for before this task stops counting, so pending can't hit 0 early */
+    if (atomic_fetch_sub(&pool->pending, 1) == 1 || adopted > 0) wake_idle_workers(pool);
+}
+
+
+static void* crawl_worker_main(void* arg) {
+    struct crawl_worker* self = arg;
+    struct worker_pool* pool = self->pool;
+    int in_flight = 0;
+
+    for (;;) {
+        /* a crawl over its memory budget may have cut down on requests in flight. workers share the cut */
+        int limit = atomic_load(&pool->state.in_flight_limit);
+        int max_in_flight = limit > 0 ? (limit + pool->workers_count - 1) / pool->workers_count : pool->max_in_flight;
+
+        while (in_flight < max_in_flight) {
+            struct crawl_task* task = deque_pop_bottom(&self->deque);
+            if (task == NULL && in_flight == 0) task = steal_task(self);
+            if (task == NULL) break;
+
+            pthread_mutex_lock(&pool->state_mutex);
+            int allowed = spend_requests(&pool->state, 1);
+            pthread_mutex_unlock(&pool->state_mutex);
+
+            if (!allowed) {
+                task->failed = 1;
+                finish_task(self, task);
+                continue;
+            }
+
+            if (!start_transfer(pool->state.crawler, self->multi, task)) {
+                finish_task(self, task);
+                continue;
+            }
+            in_flight++;
+        }
+
+        if (in_flight == 0) {
+            /* out of work of our own. the shared frontier may still hold some */
+            pthread_mutex_lock(&pool->state_mutex);
+            int ran_dry = atomic_load(&pool->pending) == 0 && task_fifo_size(&pool->state.frontier) == 0;
+
+            /* the cascades ran dry. leaves still waiting for revalidation are the last thing to do */
+            if (ran_dry && !pool->state.stopped && pool->state.leaves_count > 0) flush_leaves(&pool->state);
+            int adopted = adopt_frontier(self);
+            pthread_mutex_unlock(&pool->state_mutex);
+
+            if (adopted > 0) continue;
+            if (atomic_load(&pool->pending) == 0) break;
+
+            /* nothing to do and nothing to steal right now. wait for somebody to produce work */
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 5 * 1000000;
+            if (until.tv_nsec >= 1000000000) { until.tv_sec++; until.tv_nsec -= 1000000000; }
+
+            pthread_mutex_lock(&pool->idle_mutex);
+            pthread_cond_timedwait(&pool->work_available, &pool->idle_mutex, &until);
+            pthread_mutex_unlock(&pool->idle_mutex);
+            continue;
+        }
+
+        int still_running = 0;
+        curl_multi_perform(self->multi, &still_running);
+
+        CURLMsg *msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read(self->multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            struct crawl_task* task = finish_transfer(pool->state.crawler, self->multi, msg);
+            in_flight--;
+
+            finish_task(self, task);
+        }
+
+        if (in_flight > 0) curl_multi_poll(self->multi, NULL, 0, 10, NULL);
+    }
+
+    wake_idle_workers(pool);
+    return NULL;
+}
+
+
+int parallel_quote_search(struct crawler* crawler, const char** root_uris, int roots_count, int threads,
+                          char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count) {
+    const struct crawler_config* config = &crawler->config;
+    struct worker_pool pool = {
+        .workers_count = threads > 0 ? threads : default_parse_workers() + 1,
+        .max_in_flight = config->max_in_flight > 0 ? config->max_in_flight : DEFAULT_MAX_IN_FLIGHT
+    };
+    begin_crawl(&pool.state, crawler, visited, visited_count, all_quotes, all_quotes_count);
+    pool.state.concurrency = pool.workers_count * pool.max_in_flight;
+    pthread_mutex_init(&pool.state_mutex, NULL);
+    pthread_mutex_init(&pool.idle_mutex, NULL);
+    pthread_cond_init(&pool.work_available, NULL);
+    atomic_store(&pool.pending, 0);
+
+    pool.workers = calloc(pool.workers_count, sizeof(struct crawl_worker));
+    for (int i = 0; i < pool.workers_count; i++) {
+        pool.workers[i].pool = &pool;
+        pool.workers[i].multi = curl_multi_init();
+        pool.workers[i].steal_seed = i + 1;
+        pthread_mutex_init(&pool.workers[i].deque.mutex, NULL);
+    }
+
+    /* deal the roots out round-robin. stealing evens out whatever imbalance that leaves */
+    for (int i = 0; i < roots_count; i++) {
+        expand_post(&pool.state, root_uris[i], 0);
+        adopt_frontier(&pool.workers[i % pool.workers_count]);
+    }
+
+    for (int i = 0; i < pool.workers_count; i++) {
+        pthread_create(&pool.workers[i].thread, NULL, crawl_worker_main, &pool.workers[i]);
+    }
+    for (int i = 0; i < pool.workers_count; i++) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < pool.workers_count; i++) {
+        /* a worker only quits once pending is 0, so deques are empty by now */
+        free(pool.workers[i].deque.items);
+        pthread_mutex_destroy(&pool.workers[i].deque.mutex);
+        curl_multi_cleanup(pool.workers[i].multi);
+    }
+    free(pool.workers);
+
+    pthread_mutex_destroy(&pool.state_mutex);
+    pthread_mutex_destroy(&pool.idle_mutex);
+    pthread_cond_destroy(&pool.work_available);
+
+    return end_crawl(&pool.state);
 }
 
 
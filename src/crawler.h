@@ -1,21 +1,169 @@
 #ifndef   __CRAWLER_H__
 #define   __CRAWLER_H__
 
-/* initializes internal curl instances within crawler */
+#include <stddef.h>
+#include <json-c/json.h>
+
+/* process-wide libcurl setup. call once before creating any crawler */
 void shared_curl_init(void);
 
-/* destroys internal curl instances within crawler */
+/* process-wide libcurl teardown. call once after every crawler is destroyed */
 void shared_curl_destroy(void);
 
+/* budgets of a crawl. a field left at 0 means unlimited */
+struct crawl_limits {
+    int max_depth;           /* posts this many quotes away from the root are not expanded */
+    int max_nodes;           /* stop after collecting this many quotes */
+    int max_requests;        /* stop after issuing this many requests */
+    double deadline_seconds; /* stop this long after the crawl started, aborting in-flight transfers */
+};
+
+/* a quote as handed to sinks. the strings are borrowed and only valid during the call */
+struct quote_result {
+    const char* uri;        /* AT-URI of the quote */
+    const char* parent_uri; /* AT-URI of the post it quotes */
+    const char* author_did; /* may be NULL if the view didn't carry one */
+    int depth;              /* quotes of the root are at depth 1 */
+    int quote_count;        /* quoteCount of the quote itself, -1 if unknown */
+    int like_count;         /* likeCount of the quote, -1 if unknown */
+};
+
+/* a parent -> quote relation, seen on a getQuotes page. every collected quote comes with one,
+ * but edges are reported even for quotes that were already collected */
+struct quote_edge {
+    const char* parent_uri;
+    const char* child_uri;
+    int depth; /* depth of the child */
+};
+
+/* how a crawl went, handed to sinks once it's over */
+struct crawl_summary {
+    int quotes;    /* quotes collected by this crawl */
+    int requests;  /* requests it issued */
+    int truncated; /* a budget or cancellation cut it short */
+};
+
+/* a consumer of crawl results. any callback may be NULL. callbacks run on crawl threads, but never
+ * concurrently with each other, so a sink needs no locking of its own. blocking in a callback
+ * stalls the crawl, which is how a slow sink applies backpressure */
+struct crawl_sink {
+    void (*on_result)(void* userdata, const struct quote_result* result);
+    void (*on_edge)(void* userdata, const struct quote_edge* edge);
+    void (*on_complete)(void* userdata, const struct crawl_summary* summary);
+    void* userdata;
+};
+
+/* what a crawl's memory goes to */
+enum memory_subsystem {
+    MEMORY_FRONTIER,  /* requests waiting to be made, as far as they are in memory */
+    MEMORY_DEDUPE,    /* keys of expanded posts and collected quotes */
+    MEMORY_RESULTS,   /* what the crawl added to the caller's visited and all_quotes arrays */
+    MEMORY_RESPONSES, /* response bodies waiting to be parsed */
+    MEMORY_JSON,      /* parsed responses. json-c can't tell, so this is an estimate */
+    MEMORY_SUBSYSTEMS
+};
+
+/* memory of a subsystem. counts start over with every crawl */
+struct memory_usage {
+    size_t live;        /* bytes held right now */
+    size_t peak;        /* most bytes held at once */
+    size_t allocations; /* times memory was taken */
+    size_t frees;       /* times it was given back */
+};
+
+/* how a crawler behaves. zero-initialized is a sane default */
+struct crawler_config {
+    /* quotes whose hydrated view reports a quoteCount of 0 are never expanded with getQuotes.
+     * when set, those counts are re-checked in batches through app.bsky.feed.getPosts first,
+     * in case the page carried stale counts */
+    int revalidate_leaves;
+
+    struct crawl_limits limits;
+
+    /* concurrent transfers per network thread / worker. 0 picks a default */
+    int max_in_flight;
+
+    /* threads turning responses into records in the pipelined crawl. 0 picks a default */
+    int parse_workers;
+
+    /* bytes the frontier, the requests a crawl has yet to make, may take in memory. 0 for no limit.
+     * newer requests spill to segment files in `spill_dir` (NULL for $TMPDIR or /tmp) and come
+     * back in order once the older ones are handed out. once `spill_budget` bytes (0 for no limit)
+     * are on disk as well, no new requests are started: the ones in flight land and the crawl ends
+     * truncated, like with any other budget */
+    size_t frontier_memory;
+    const char* spill_dir;
+    size_t spill_budget;
+
+    /* bytes a crawl may hold in its frontier, responses and parsed trees together, 0 for no limit.
+     * dedupe keys and results can't be shed, so they don't count. once it holds more, the crawl
+     * sheds what it can, a step a second: it empties the page cache, spills the frontier to disk,
+     * then keeps halving the frontier's memory and the requests in flight, down to a floor. back
+     * under half the budget, it undoes those steps the same way */
+    size_t memory_budget;
+
+    /* where results go as soon as they are found, in order. the array must outlive the crawls */
+    const struct crawl_sink* sinks;
+    int sinks_count;
+
+    /* file get_did() keeps handle -> DID answers in across runs, NULL for none. entries older than
+     * `did_cache_ttl` seconds (0 picks a default) are still used, but refreshed in the background */
+    const char* did_cache_path;
+    double did_cache_ttl;
+
+    /* file getQuotes responses are kept in across runs, NULL for none. responses younger than
+     * `http_cache_ttl` seconds (0 picks a default) are used without asking, older ones are
+     * revalidated with If-None-Match. budgets count cached responses like requests */
+    const char* http_cache_path;
+    double http_cache_ttl;
+
+    /* getQuotes pages shared by crawls of this process, NULL for none. crawls of overlapping
+     * cascades then only fetch the pages no earlier crawl did. may be shared between crawlers */
+    struct page_cache* page_cache;
+
+    /* file every crawl journals its progress to, NULL for none. the journal reaches the disk at
+     * least every `checkpoint_interval` seconds (0 picks a default). with `resume`, a crawl first
+     * restores whatever the file holds: its quotes are handed out again and only unfinished posts
+     * are fetched. otherwise the file starts over */
+    const char* checkpoint_path;
+    double checkpoint_interval;
+    int resume;
+
+    /* like `resume`, but for bringing a crawl up to date: the quotes it holds count as known and
+     * aren't handed out again. the quoteCount of every known post is checked through batched
+     * app.bsky.feed.getPosts calls, and only posts that gained quotes are crawled again, until
+     * their pages stop turning up new quotes */
+    int incremental;
+};
+
+/* a crawler context: its own connections, config and cancellation state. crawlers share nothing,
+ * so any number of them can crawl side by side. a single crawler runs one crawl at a time */
+struct crawler;
+
+/* `config` may be NULL for defaults. returns NULL if curl couldn't be set up */
+struct crawler* crawler_create(const struct crawler_config* config);
+
+void crawler_destroy(struct crawler* crawler);
+
+/* config the next crawl will run with */
+const struct crawler_config* crawler_get_config(const struct crawler* crawler);
+
+/* takes effect with the next crawl */
+void crawler_set_config(struct crawler* crawler, const struct crawler_config* config);
+
+/* memory the running or last crawl of `crawler` holds, per subsystem. safe to call from any thread */
+void crawler_get_memory(struct crawler* crawler, struct memory_usage usage[MEMORY_SUBSYSTEMS]);
+
 /* get actor/handle of a user from a post url. example:
  * input: "https://bsky.app/profile/413x1nkp.bsky.social/post/3ldzgecezms2d";
  * output: "413x1nkp.bsky.social" */
 const char* get_actor(const char* post);
 
-/* request DID of an actor. example:
+/* request DID of an actor, or take it from the DID cache. DIDs are returned as they are.
+ * the result is always to be freed, it's "unk" if the lookup failed. example:
  * input: "413x1nkp.bsky.social";
  * output: "did:plc:ybflevxvh5zylcoxbohxu224" */
-char* get_did(const char *actor);
+char* get_did(struct crawler* crawler, const char *actor);
 
 /* extract post id from the post url. example:
  * input: "https://bsky.app/profile/413x1nkp.bsky.social/post/3ldzgecezms2d";
@@ -27,8 +175,45 @@ char* extract_post_id(const char* url);
  * output: "https://bsky.app/profile/did:plc:ybflevxvh5zylcoxbohxu224/post/3l7det4aqy52h" */
 char* post_uri_to_https(const char *uri);
 
-/* recursively find all quotes and store the ATPROTO links to each one in `char*** all_quotes` */
-void recursive_quote_search(const char* actor_did, const char* post_id,
-                            char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count);
+/* fetch the first getQuotes page of a post. caller owns the returned object, NULL on failure */
+json_object* get_quotes(struct crawler* crawler, const char* actor_did, const char* post_id);
+
+/* quoteCount of a hydrated post view. -1 if the view doesn't carry one */
+int get_quote_count(json_object* post);
+
+/* fetch quoteCount of every AT-URI in `uris` through batched app.bsky.feed.getPosts calls.
+ * `counts[i]` receives the count of `uris[i]`, -1 if it couldn't be fetched */
+void get_quote_counts(struct crawler* crawler, const char** uris, int uris_count, int* counts);
+
+/* fetch the handle of every DID in `dids` through batched app.bsky.actor.getProfiles calls.
+ * `handles[i]` receives the handle of `dids[i]` to be freed, NULL if there is none.
+ * safe to call while the crawler runs a crawl on another thread */
+void get_handles(struct crawler* crawler, const char** dids, int dids_count, char** handles);
+
+/* get DID from given AT-URI. example:
+ * input: "at://did:plc:ybflevxvh5zylcoxbohxu224/app.bsky.feed.post/3l7det4aqy52h";
+ * output: "did:plc:ybflevxvh5zylcoxbohxu224" */
+char* get_did_from_uri(const char* uri);
+
+/* stop the running crawl of `crawler` as soon as possible, aborting in-flight transfers.
+ * safe to call from any thread. the crawl returns whatever it collected so far as truncated */
+void cancel_quote_search(struct crawler* crawler);
+
+/* find all quotes of a post, quotes of those quotes and so on, and store the ATPROTO links to each one
+ * in `char*** all_quotes`. posts that got expanded are recorded in `visited` as `did/post_id`.
+ * either array may be NULL (with its count) when the sinks are all the caller wants.
+ * fetching and parsing run as a pipeline on their own threads, with the calling thread doing the
+ * bookkeeping and feeding the sinks.
+ * returns 1 if a budget or cancellation cut the crawl short (the result is partial), 0 otherwise */
+int recursive_quote_search(struct crawler* crawler, const char* actor_did, const char* post_id,
+                           char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count);
+
+/* same as recursive_quote_search(), but for any number of roots (AT-URIs) at once, crawled by
+ * `threads` worker threads (0 picks a default). every worker owns its own connections and frontier
+ * and steals work from the others when it runs dry; dedupe, results and budgets are shared, so a
+ * subtree reachable from several roots is fetched once. workers take turns feeding the sinks.
+ * returns 1 if the result is partial, 0 otherwise */
+int parallel_quote_search(struct crawler* crawler, const char** root_uris, int roots_count, int threads,
+                          char*** visited, int* visited_count, char*** all_quotes, int* all_quotes_count);
 
 #endif /* __CRAWLER_H__ */
@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef HAVE_SQLITE
+#include <sqlite3.h>
+#endif
+
+#include "database.h"
+#include "ring.h"
+
+/* results that may pile up between the crawl and the writer thread */
+#define DATABASE_RING_CAPACITY 8192
+
+#ifdef HAVE_SQLITE
+
+static const char* SCHEMA =
+    "PRAGMA journal_mode = WAL;"
+    "PRAGMA synchronous = NORMAL;"
+    "CREATE TABLE IF NOT EXISTS posts ("
+    "    uri TEXT PRIMARY KEY,"
+    "    author TEXT,"
+    "    depth INTEGER,"
+    "    quote_count INTEGER"
+    ");"
+    "CREATE TABLE IF NOT EXISTS edges ("
+    "    parent_uri TEXT NOT NULL,"
+    "    child_uri TEXT NOT NULL,"
+    "    PRIMARY KEY (parent_uri, child_uri)"
+    ") WITHOUT ROWID;";
+
+struct database_writer {
+    sqlite3* db;
+    sqlite3_stmt* insert_root;
+    sqlite3_stmt* insert_post;
+    sqlite3_stmt* insert_edge;
+    int batch;
+    int rows;
+    int failed;
+
+    struct result_ring ring;
+    pthread_t thread;
+};
+
+
+static int exec(struct database_writer* writer, const char* sql) {
+    char* error = NULL;
+    if (sqlite3_exec(writer->db, sql, NULL, NULL, &error) == SQLITE_OK) return 1;
+
+    fprintf(stderr, "sqlite: %s\n", error);
+    sqlite3_free(error);
+    return 0;
+}
+
+
+/* run a prepared statement once and get it ready for the next row */
+static int step(struct database_writer* writer, sqlite3_stmt* stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if (rc == SQLITE_DONE) return 1;
+
+    fprintf(stderr, "sqlite: %s\n", sqlite3_errmsg(writer->db));
+    return 0;
+}
+
+
+static int insert_record(struct database_writer* writer, const struct result_record* record) {
+    /* the parent of a depth 1 quote is a root, which never shows up as a result of its own */
+    if (record->depth == 1) {
+        sqlite3_bind_text(writer->insert_root, 1, record->parent_uri, -1, SQLITE_STATIC);
+        if (!step(writer, writer->insert_root)) return 0;
+    }
+
+    sqlite3_bind_text(writer->insert_post, 1, record->uri, -1, SQLITE_STATIC);
+    if (record->author_did) sqlite3_bind_text(writer->insert_post, 2, record->author_did, -1, SQLITE_STATIC);
+    sqlite3_bind_int(writer->insert_post, 3, record->depth);
+    if (record->quote_count >= 0) sqlite3_bind_int(writer->insert_post, 4, record->quote_count);
+    if (!step(writer, writer->insert_post)) return 0;
+
+    sqlite3_bind_text(writer->insert_edge, 1, record->parent_uri, -1, SQLITE_STATIC);
+    sqlite3_bind_text(writer->insert_edge, 2, record->uri, -1, SQLITE_STATIC);
+    return step(writer, writer->insert_edge);
+}
+
+
+static void* database_main(void* arg) {
+    struct database_writer* writer = arg;
+    struct result_record record;
+    int in_batch = 0;
+
+    for (;;) {
+        /* caught up with the crawl: commit what we have rather than sit on it while waiting */
+        if (!result_ring_try_pop(&writer->ring, &record)) {
+            if (in_batch > 0 && !exec(writer, "COMMIT")) writer->failed = 1;
+            in_batch = 0;
+            if (!result_ring_pop(&writer->ring, &record)) break;
+        }
+
+        /* after a failure keep draining so the crawl never blocks on a full ring */
+        if (!writer->failed) {
+            if (in_batch == 0 && !exec(writer, "BEGIN")) writer->failed = 1;
+            else if (!insert_record(writer, &record)) writer->failed = 1;
+            else writer->rows++;
+
+            if (!writer->failed && ++in_batch == writer->batch) {
+                if (!exec(writer, "COMMIT")) writer->failed = 1;
+                in_batch = 0;
+            }
+        }
+        result_record_free(&record);
+    }
+
+    if (in_batch > 0 && !writer->failed && !exec(writer, "COMMIT")) writer->failed = 1;
+    return NULL;
+}
+
+
+/* the crawl side: copy and queue. the record stops being borrowed here */
+static void queue_result(void* userdata, const struct quote_result* result) {
+    struct database_writer* writer = userdata;
+    result_ring_push(&writer->ring, (struct result_record){
+        .uri = strdup(result->uri),
+        .parent_uri = strdup(result->parent_uri),
+        .author_did = result->author_did ? strdup(result->author_did) : NULL,
+        .depth = result->depth,
+        .quote_count = result->quote_count
+    });
+}
+
+
+static void close_db(struct database_writer* writer) {
+    sqlite3_finalize(writer->insert_root);
+    sqlite3_finalize(writer->insert_post);
+    sqlite3_finalize(writer->insert_edge);
+    if (sqlite3_close(writer->db) != SQLITE_OK) {
+        fprintf(stderr, "sqlite: %s\n", sqlite3_errmsg(writer->db));
+        writer->failed = 1;
+    }
+}
+
+
+struct database_writer* database_writer_open(const char* path, int batch) {
+    struct database_writer* writer = calloc(1, sizeof(struct database_writer));
+    writer->batch = batch > 0 ? batch : DEFAULT_DATABASE_BATCH;
+
+    if (sqlite3_open(path, &writer->db) != SQLITE_OK) {
+        fprintf(stderr, "%s: %s\n", path, sqlite3_errmsg(writer->db));
+        sqlite3_close(writer->db);
+        free(writer);
+        return NULL;
+    }
+
+    /* a re-crawl updates the posts it finds again */
+    int ok = exec(writer, SCHEMA)
+          && sqlite3_prepare_v2(writer->db, "INSERT OR IGNORE INTO posts (uri, depth) VALUES (?1, 0)",
+                                -1, &writer->insert_root, NULL) == SQLITE_OK
+          && sqlite3_prepare_v2(writer->db, "INSERT OR REPLACE INTO posts (uri, author, depth, quote_count) "
+                                            "VALUES (?1, ?2, ?3, ?4)",
+                                -1, &writer->insert_post, NULL) == SQLITE_OK
+          && sqlite3_prepare_v2(writer->db, "INSERT OR IGNORE INTO edges (parent_uri, child_uri) VALUES (?1, ?2)",
+                                -1, &writer->insert_edge, NULL) == SQLITE_OK;
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", path, sqlite3_errmsg(writer->db));
+        close_db(writer);
+        free(writer);
+        return NULL;
+    }
+
+    result_ring_init(&writer->ring, DATABASE_RING_CAPACITY);
+    if (pthread_create(&writer->thread, NULL, database_main, writer) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        result_ring_destroy(&writer->ring);
+        close_db(writer);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+
+struct crawl_sink database_writer_sink(struct database_writer* writer) {
+    return (struct crawl_sink){
+        .on_result = queue_result,
+        .userdata = writer
+    };
+}
+
+
+int database_writer_close(struct database_writer* writer) {
+    result_ring_close(&writer->ring);
+    pthread_join(writer->thread, NULL);
+    result_ring_destroy(&writer->ring);
+    close_db(writer);
+
+    int rows = writer->failed ? -1 : writer->rows;
+    free(writer);
+    return rows;
+}
+
+#else
+
+struct database_writer* database_writer_open(const char* path, int batch) {
+    (void)path;
+    (void)batch;
+    fprintf(stderr, "database output needs a build with sqlite (SQLITE=1)\n");
+    return NULL;
+}
+
+
+struct crawl_sink database_writer_sink(struct database_writer* writer) {
+    return (struct crawl_sink){ .userdata = writer };
+}
+
+
+int database_writer_close(struct database_writer* writer) {
+    (void)writer;
+    return -1;
+}
+
+#endif /* HAVE_SQLITE */
@@ -0,0 +1,29 @@
+#ifndef   __DATABASE_H__
+#define   __DATABASE_H__
+
+#include "crawler.h"
+
+/* batch size when none is given */
+#define DEFAULT_DATABASE_BATCH 10000
+
+/* loads crawl results into an SQLite database:
+ *
+ *   posts (uri PRIMARY KEY, author, depth, quote_count)   roots are at depth 0
+ *   edges (parent_uri, child_uri)                         one per quote
+ *
+ * the crawl only copies each result into a ring. a writer thread drains it through prepared
+ * statements, committing every `batch` rows and whenever it catches up with the crawl */
+struct database_writer;
+
+/* open or create the database at `path` in WAL mode. `batch` <= 0 picks DEFAULT_DATABASE_BATCH.
+ * needs a build with SQLITE=1. returns NULL if the database can't be used */
+struct database_writer* database_writer_open(const char* path, int batch);
+
+/* a sink feeding the writer. callbacks must not run concurrently, which the crawler guarantees */
+struct crawl_sink database_writer_sink(struct database_writer* writer);
+
+/* write out whatever is still queued, stop the writer thread and close the database.
+ * returns the number of posts written, -1 if anything failed along the way */
+int database_writer_close(struct database_writer* writer);
+
+#endif /* __DATABASE_H__ */
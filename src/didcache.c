@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "didcache.h"
+#include "strset.h"
+
+#define DID_CACHE_MAGIC   "QCDIDS\0\0"
+#define DID_CACHE_VERSION 1
+
+/* slots in the file. plenty for the few accounts a job runner keeps coming back to */
+#define DID_CACHE_SLOTS 4096
+
+/* slots looked at per handle before the oldest one gets evicted */
+#define DID_CACHE_PROBES 16
+
+/* handles are at most 253 characters. longer DIDs are valid but rare, they just don't get cached */
+#define DID_CACHE_HANDLE_SIZE 256
+#define DID_CACHE_DID_SIZE    192
+
+struct did_cache_slot {
+    int64_t fetched_at; /* unix seconds, 0 for an empty slot */
+    char handle[DID_CACHE_HANDLE_SIZE];
+    char did[DID_CACHE_DID_SIZE];
+};
+
+struct did_cache_file {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots_count;
+    struct did_cache_slot slots[];
+};
+
+struct did_cache {
+    int fd;
+    struct did_cache_file* file;
+    size_t size;
+    double ttl;
+
+    /* flock() only excludes other processes. threads of this one queue up here first */
+    pthread_mutex_t mutex;
+};
+
+
+struct did_cache* did_cache_open(const char* path, double ttl_seconds) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    size_t size = sizeof(struct did_cache_file) + DID_CACHE_SLOTS * sizeof(struct did_cache_slot);
+
+    /* whoever gets here first lays the file out. the others wait and find it ready */
+    flock(fd, LOCK_EX);
+    struct stat st;
+    int fresh = fstat(fd, &st) == 0 && st.st_size == 0;
+    if (fresh && ftruncate(fd, size) != 0) {
+        perror("ftruncate");
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    struct did_cache_file* file = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (file == MAP_FAILED) {
+        perror("mmap");
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    if (fresh) {
+        memcpy(file->magic, DID_CACHE_MAGIC, sizeof(file->magic));
+        file->version = DID_CACHE_VERSION;
+        file->slots_count = DID_CACHE_SLOTS;
+    }
+    int valid = (fresh || (size_t)st.st_size == size)
+             && memcmp(file->magic, DID_CACHE_MAGIC, sizeof(file->magic)) == 0
+             && file->version == DID_CACHE_VERSION && file->slots_count == DID_CACHE_SLOTS;
+    flock(fd, LOCK_UN);
+
+    if (!valid) {
+        fprintf(stderr, "%s: not a version %d DID cache\n", path, DID_CACHE_VERSION);
+        munmap(file, size);
+        close(fd);
+        return NULL;
+    }
+
+    struct did_cache* cache = calloc(1, sizeof(struct did_cache));
+    cache->fd = fd;
+    cache->file = file;
+    cache->size = size;
+    cache->ttl = ttl_seconds > 0 ? ttl_seconds : DEFAULT_DID_CACHE_TTL;
+    pthread_mutex_init(&cache->mutex, NULL);
+    return cache;
+}
+
+
+void did_cache_close(struct did_cache* cache) {
+    if (cache == NULL) return;
+    munmap(cache->file, cache->size);
+    close(cache->fd);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+
+/* handles are case-insensitive. 0 if it doesn't fit a slot */
+static int normalize(const char* handle, char out[DID_CACHE_HANDLE_SIZE]) {
+    size_t len = strlen(handle);
+    if (len == 0 || len >= DID_CACHE_HANDLE_SIZE) return 0;
+    for (size_t i = 0; i <= len; i++) out[i] = (char)tolower((unsigned char)handle[i]);
+    return 1;
+}
+
+
+static void lock(struct did_cache* cache, int operation) {
+    pthread_mutex_lock(&cache->mutex);
+    flock(cache->fd, operation);
+}
+
+
+static void unlock(struct did_cache* cache) {
+    flock(cache->fd, LOCK_UN);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+
+char* did_cache_lookup(struct did_cache* cache, const char* handle, int* stale) {
+    char key[DID_CACHE_HANDLE_SIZE];
+    if (!normalize(handle, key)) return NULL;
+
+    char* did = NULL;
+    size_t start = strset_hash(key) % DID_CACHE_SLOTS;
+
+    lock(cache, LOCK_SH);
+    for (size_t i = 0; i < DID_CACHE_PROBES; i++) {
+        const struct did_cache_slot* slot = &cache->file->slots[(start + i) % DID_CACHE_SLOTS];
+        if (slot->fetched_at == 0 || strcmp(slot->handle, key) != 0) continue;
+
+        did = strdup(slot->did);
+        *stale = difftime(time(NULL), (time_t)slot->fetched_at) > cache->ttl;
+        break;
+    }
+    unlock(cache);
+    return did;
+}
+
+
+void did_cache_store(struct did_cache* cache, const char* handle, const char* did) {
+    char key[DID_CACHE_HANDLE_SIZE];
+    if (!normalize(handle, key) || strlen(did) >= DID_CACHE_DID_SIZE) return;
+
+    size_t start = strset_hash(key) % DID_CACHE_SLOTS;
+
+    lock(cache, LOCK_EX);
+
+    /* the handle's own slot if it has one, otherwise an empty one, otherwise the oldest */
+    struct did_cache_slot* target = NULL;
+    for (size_t i = 0; i < DID_CACHE_PROBES; i++) {
+        struct did_cache_slot* slot = &cache->file->slots[(start + i) % DID_CACHE_SLOTS];
+        if (slot->fetched_at != 0 && strcmp(slot->handle, key) == 0) {
+            target = slot;
+            break;
+        }
+        if (target == NULL || (target->fetched_at != 0 && slot->fetched_at < target->fetched_at)) target = slot;
+    }
+
+    strcpy(target->handle, key);
+    strcpy(target->did, did);
+    target->fetched_at = (int64_t)time(NULL);
+
+    unlock(cache);
+}
@@ -0,0 +1,25 @@
+#ifndef   __DIDCACHE_H__
+#define   __DIDCACHE_H__
+
+/* entries older than this are stale unless told otherwise */
+#define DEFAULT_DID_CACHE_TTL (24 * 60 * 60)
+
+/* persistent handle -> DID cache. the file is a fixed-size hash table mmap()ed shared, so lookups
+ * are a probe through memory, and every process using the same file sees every other one's
+ * entries. writes take an flock(), so any number of processes and threads can share a file. when
+ * a probe window is full, the oldest entry in it makes room */
+struct did_cache;
+
+/* open or create the cache at `path`. `ttl_seconds` <= 0 picks DEFAULT_DID_CACHE_TTL.
+ * returns NULL if the file can't be used */
+struct did_cache* did_cache_open(const char* path, double ttl_seconds);
+void did_cache_close(struct did_cache* cache);
+
+/* DID cached for `handle`, to be freed. NULL if there is none. `*stale` tells whether it's past
+ * its TTL, in which case it's still the best guess but wants refreshing */
+char* did_cache_lookup(struct did_cache* cache, const char* handle, int* stale);
+
+/* remember `did` for `handle`, as of now */
+void did_cache_store(struct did_cache* cache, const char* handle, const char* did);
+
+#endif /* __DIDCACHE_H__ */
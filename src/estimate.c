@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <json-c/json.h>
+
+#include "crawler.h"
+#include "estimate.h"
+
+/* walks past this depth are cut short. real cascades are nowhere near this deep */
+#define MAX_WALK_DEPTH 256
+
+/* upper bound on walks, for when every page we need is already fetched */
+#define MAX_PROBES 4096
+
+/* z-score for ~95% two-sided confidence */
+#define CONFIDENCE_Z 1.96
+
+/* a getQuotes page we already paid for */
+struct estimate_page {
+    char* uri;
+    json_object* response;
+};
+
+struct estimate_state {
+    struct crawler* crawler;
+    struct estimate_page* pages;
+    int pages_count;
+    int requests;
+    int request_budget;
+    uint64_t rng;
+};
+
+
+/* xorshift64*. good enough for picking branches, and reproducible per seed */
+static uint64_t next_random(struct estimate_state* st) {
+    st->rng ^= st->rng >> 12;
+    st->rng ^= st->rng << 25;
+    st->rng ^= st->rng >> 27;
+    return st->rng * 0x2545F4914F6CDD1DULL;
+}
+
+
+/* posts array of the getQuotes page for `uri`. fetches it if we still have budget.
+ * NULL if out of budget or the request failed */
+static json_object* page_posts(struct estimate_state* st, const char* uri) {
+    json_object* posts;
+
+    for (int i = 0; i < st->pages_count; i++) {
+        if (strcmp(st->pages[i].uri, uri) != 0) continue;
+        if (st->pages[i].response == NULL) return NULL;
+        return json_object_object_get_ex(st->pages[i].response, "posts", &posts) ? posts : NULL;
+    }
+
+    if (st->requests >= st->request_budget) return NULL;
+
+    char* did = get_did_from_uri(uri);
+    char* post_id = extract_post_id(uri);
+    json_object* response = get_quotes(st->crawler, did, post_id);
+    st->requests++;
+    free(did);
+    free(post_id);
+
+    /* failed pages are cached too, so we don't pay for them twice */
+    st->pages = realloc(st->pages, (st->pages_count + 1) * sizeof(struct estimate_page));
+    st->pages[st->pages_count].uri = strdup(uri);
+    st->pages[st->pages_count].response = response;
+    st->pages_count++;
+
+    if (response == NULL) return NULL;
+    return json_object_object_get_ex(response, "posts", &posts) ? posts : NULL;
+}
+
+
+/* one random walk down from `uri`, which has `quote_count` direct quotes.
+ * returns the estimated number of posts below it. clears `*complete` if the walk
+ * had to stop early because of the budget */
+static double probe(struct estimate_state* st, const char* uri, int quote_count, int depth, int* complete) {
+    if (quote_count == 0) return 0;
+
+    json_object* posts = depth < MAX_WALK_DEPTH ? page_posts(st, uri) : NULL;
+    if (posts == NULL) {
+        *complete = 0;
+        return quote_count;
+    }
+
+    int page_len = json_object_array_length(posts);
+    if (page_len == 0) return quote_count;
+
+    /* the page may be shorter than quote_count (there is a cursor). whatever fraction of the
+     * page has quotes of its own is assumed to hold for the unseen rest too */
+    int internal_count = 0;
+    int picked = -1;
+    for (int i = 0; i < page_len; i++) {
+        json_object* post = json_object_array_get_idx(posts, i);
+        if (get_quote_count(post) == 0) continue;
+        internal_count++;
+        /* reservoir sampling, so we pick uniformly in a single pass */
+        if (next_random(st) % internal_count == 0) picked = i;
+    }
+
+    /* the appview may report a stale count for the parent. trust the page if it's bigger */
+    double direct = quote_count > page_len ? quote_count : page_len;
+    if (internal_count == 0) return direct;
+
+    json_object* post = json_object_array_get_idx(posts, picked);
+    const char* child_uri = json_object_get_string(json_object_object_get(post, "uri"));
+    int child_count = get_quote_count(post);
+    if (child_uri == NULL) return direct;
+
+    /* -1 means unknown. walk into it anyway and let the page tell */
+    double below = probe(st, child_uri, child_count < 0 ? 1 : child_count, depth + 1, complete);
+    return direct + (direct / page_len) * internal_count * below;
+}
+
+
+struct cascade_estimate estimate_cascade_size(struct crawler* crawler, const char* actor_did, const char* post_id,
+                                              int request_budget, unsigned int seed) {
+    struct cascade_estimate result = {0};
+    struct estimate_state st = {
+        .crawler = crawler,
+        .pages = NULL,
+        .pages_count = 0,
+        .requests = 0,
+        .request_budget = request_budget,
+        .rng = seed ? seed : 0x9E3779B97F4A7C15ULL
+    };
+
+    char root_uri[256];
+    snprintf(root_uri, sizeof(root_uri), "at://%s/app.bsky.feed.post/%s", actor_did, post_id);
+
+    /* the root's own quoteCount isn't part of its getQuotes page */
+    int root_count = -1;
+    if (st.requests < st.request_budget) {
+        const char* uris[1] = { root_uri };
+        get_quote_counts(crawler, uris, 1, &root_count);
+        st.requests++;
+    }
+
+    double sum = 0, sum_sq = 0;
+    double partial_sum = 0, partial_sum_sq = 0;
+    int partial_probes = 0;
+
+    if (root_count != 0) {
+        for (int i = 0; i < MAX_PROBES; i++) {
+            int requests_before = st.requests;
+            int complete = 1;
+            double x = probe(&st, root_uri, root_count < 0 ? 1 : root_count, 0, &complete);
+
+            if (complete) {
+                sum += x; sum_sq += x * x;
+                result.probes++;
+            } else {
+                partial_sum += x; partial_sum_sq += x * x;
+                partial_probes++;
+            }
+
+            /* out of budget and the last walk couldn't buy anything either */
+            if (st.requests >= st.request_budget && st.requests == requests_before && !complete) break;
+        }
+    }
+
+    /* with no complete walk at all, truncated walks are the best we have (they're biased low) */
+    if (result.probes == 0 && partial_probes > 0) {
+        sum = partial_sum; sum_sq = partial_sum_sq;
+        result.probes = partial_probes;
+    }
+
+    if (result.probes > 0) {
+        double n = result.probes;
+        double mean = sum / n;
+        double variance = n > 1 ? (sum_sq - n * mean * mean) / (n - 1) : mean * mean;
+        double margin = CONFIDENCE_Z * sqrt(variance > 0 ? variance : 0) / sqrt(n);
+
+        result.size = mean;
+        result.low = mean - margin;
+        result.high = mean + margin;
+    }
+
+    /* direct quotes of the root are certain */
+    if (root_count > 0 && result.low < root_count) result.low = root_count;
+    if (result.size < result.low) result.size = result.low;
+    if (result.high < result.size) result.high = result.size;
+
+    result.requests = st.requests;
+
+    for (int i = 0; i < st.pages_count; i++) {
+        free(st.pages[i].uri);
+        json_object_put(st.pages[i].response);
+    }
+    free(st.pages);
+
+    return result;
+}
@@ -0,0 +1,22 @@
+#ifndef   __ESTIMATE_H__
+#define   __ESTIMATE_H__
+
+#include "crawler.h"
+
+/* result of a sampled cascade size estimation */
+struct cascade_estimate {
+    double size;  /* estimated number of quotes in the whole cascade (root excluded) */
+    double low;   /* lower ~95% confidence bound */
+    double high;  /* upper ~95% confidence bound */
+    int probes;   /* random walks that made it into the estimate */
+    int requests; /* requests spent, never more than the budget */
+};
+
+/* estimate how many quotes a cascade holds without crawling it. walks random root-to-leaf
+ * paths (Knuth's estimator), using quoteCount of every post on a fetched page so only posts
+ * that have quotes of their own cost a request. stops once `request_budget` requests are spent.
+ * `seed` makes the walks reproducible. requests go through `crawler` */
+struct cascade_estimate estimate_cascade_size(struct crawler* crawler, const char* actor_did, const char* post_id,
+                                              int request_budget, unsigned int seed);
+
+#endif /* __ESTIMATE_H__ */
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handles.h"
+
+
+void handle_resolver_init(struct handle_resolver* resolver) {
+    *resolver = (struct handle_resolver){0};
+    intern_init(&resolver->dids);
+}
+
+
+void handle_resolver_free(struct handle_resolver* resolver) {
+    for (size_t i = 0; i < resolver->resolved; i++) free(resolver->handles[i]);
+    free(resolver->handles);
+    intern_free(&resolver->dids);
+    *resolver = (struct handle_resolver){0};
+}
+
+
+void handle_resolver_add(struct handle_resolver* resolver, const char* did) {
+    intern_add(&resolver->dids, did);
+}
+
+
+void handle_resolver_resolve(struct handle_resolver* resolver, struct crawler* crawler) {
+    size_t pending = handle_resolver_pending(resolver);
+    if (pending == 0) return;
+
+    if (resolver->dids.count > resolver->capacity) {
+        resolver->capacity = resolver->dids.count * 2;
+        resolver->handles = realloc(resolver->handles, resolver->capacity * sizeof(char*));
+    }
+
+    /* interned strings sit in id order, so the pending ones are one contiguous run */
+    get_handles(crawler, (const char**)resolver->dids.strings + resolver->resolved, (int)pending,
+                resolver->handles + resolver->resolved);
+    resolver->resolved = resolver->dids.count;
+}
+
+
+const char* handle_resolver_get(const struct handle_resolver* resolver, const char* did) {
+    int id = intern_find(&resolver->dids, did);
+    if (id < 0 || (size_t)id >= resolver->resolved) return NULL;
+    return resolver->handles[id];
+}
+
+
+char* handle_resolver_link(const struct handle_resolver* resolver, const char* uri) {
+    char* did = get_did_from_uri(uri);
+    const char* handle = handle_resolver_get(resolver, did);
+    free(did);
+    if (handle == NULL) return post_uri_to_https(uri);
+
+    const char* post_id = strrchr(uri, '/');
+    char* link = malloc(strlen(handle) + strlen(post_id) + 64);
+    sprintf(link, "https://bsky.app/profile/%s/post%s", handle, post_id);
+    return link;
+}
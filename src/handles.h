@@ -0,0 +1,39 @@
+#ifndef   __HANDLES_H__
+#define   __HANDLES_H__
+
+#include <stddef.h>
+
+#include "crawler.h"
+#include "intern.h"
+
+/* turns author DIDs back into handles for readable output. DIDs are queued as they show up and
+ * looked up together, 25 per getProfiles call with every call in flight at once. each DID is
+ * looked up once, hit or miss. not thread-safe */
+struct handle_resolver {
+    struct intern_table dids;
+    char** handles;  /* by DID id. NULL if unknown (yet) */
+    size_t resolved; /* ids below this were looked up */
+    size_t capacity;
+};
+
+void handle_resolver_init(struct handle_resolver* resolver);
+void handle_resolver_free(struct handle_resolver* resolver);
+
+/* queue `did` for the next handle_resolver_resolve(), unless it's known already */
+void handle_resolver_add(struct handle_resolver* resolver, const char* did);
+
+/* DIDs waiting for a lookup */
+static inline size_t handle_resolver_pending(const struct handle_resolver* resolver) {
+    return resolver->dids.count - resolver->resolved;
+}
+
+/* look up every queued DID */
+void handle_resolver_resolve(struct handle_resolver* resolver, struct crawler* crawler);
+
+/* handle of `did`, NULL if it's unknown */
+const char* handle_resolver_get(const struct handle_resolver* resolver, const char* did);
+
+/* like post_uri_to_https(), with the handle in place of the DID where it's known. to be freed */
+char* handle_resolver_link(const struct handle_resolver* resolver, const char* uri);
+
+#endif /* __HANDLES_H__ */
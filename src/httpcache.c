@@ -0,0 +1,362 @@
+#define _GNU_SOURCE /* F_OFD_SETLK */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "httpcache.h"
+#include "strset.h"
+
+#define HTTP_CACHE_MAGIC   "QCHTTP\0\0"
+#define HTTP_CACHE_VERSION 1
+
+/* the file is locked a byte at a time. every process that has it open holds a shared lock on
+ * OPEN_LOCK, appends take an exclusive one on APPEND_LOCK */
+#define OPEN_LOCK   0
+#define APPEND_LOCK 1
+
+struct http_cache_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+/* on disk, followed by the url, the ETag and the body, none of them NUL-terminated */
+struct http_cache_record {
+    uint32_t url_len;
+    uint32_t etag_len;
+    uint32_t body_len;
+    uint32_t reserved;
+    int64_t fetched_at; /* unix seconds. rewritten in place when a response is revalidated */
+};
+
+/* where the newest record of a url lives. url is NULL for an empty slot */
+struct index_entry {
+    char* url;
+    uint64_t offset;
+    uint32_t etag_len;
+    uint32_t body_len;
+    int64_t fetched_at;
+};
+
+struct http_cache {
+    char* path;
+    int fd;
+    double ttl;
+    pthread_mutex_t mutex;
+
+    struct index_entry* entries; /* open addressing, at most half full */
+    size_t capacity;
+    size_t count;
+
+    uint64_t live_bytes; /* bytes of records the index points at */
+    uint64_t end;        /* where the next record goes */
+};
+
+
+static int range_lock(int fd, short type, off_t start, int wait) {
+    struct flock lock = { .l_type = type, .l_whence = SEEK_SET, .l_start = start, .l_len = 1 };
+    return fcntl(fd, wait ? F_OFD_SETLKW : F_OFD_SETLK, &lock);
+}
+
+
+static uint64_t record_size(uint32_t url_len, uint32_t etag_len, uint32_t body_len) {
+    return sizeof(struct http_cache_record) + (uint64_t)url_len + etag_len + body_len;
+}
+
+
+static struct index_entry* find_slot(struct http_cache* cache, const char* url) {
+    size_t i = strset_hash(url) & (cache->capacity - 1);
+    while (cache->entries[i].url && strcmp(cache->entries[i].url, url) != 0) {
+        i = (i + 1) & (cache->capacity - 1);
+    }
+    return &cache->entries[i];
+}
+
+
+static void clear_index(struct http_cache* cache) {
+    for (size_t i = 0; i < cache->capacity; i++) free(cache->entries[i].url);
+    memset(cache->entries, 0, cache->capacity * sizeof(struct index_entry));
+    cache->count = 0;
+    cache->live_bytes = 0;
+}
+
+
+static void grow_index(struct http_cache* cache) {
+    struct index_entry* old = cache->entries;
+    size_t old_capacity = cache->capacity;
+
+    cache->capacity = old_capacity ? old_capacity * 2 : 1024;
+    cache->entries = calloc(cache->capacity, sizeof(struct index_entry));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].url) *find_slot(cache, old[i].url) = old[i];
+    }
+    free(old);
+}
+
+
+/* point the index at a record. whatever it pointed at before is dead now */
+static void index_record(struct http_cache* cache, const char* url, size_t url_len, uint64_t offset,
+                         const struct http_cache_record* record) {
+    if ((cache->count + 1) * 2 > cache->capacity) grow_index(cache);
+
+    char* key = strndup(url, url_len);
+    struct index_entry* slot = find_slot(cache, key);
+    if (slot->url) {
+        cache->live_bytes -= record_size(url_len, slot->etag_len, slot->body_len);
+        free(key);
+    } else {
+        slot->url = key;
+        cache->count++;
+    }
+    slot->offset = offset;
+    slot->etag_len = record->etag_len;
+    slot->body_len = record->body_len;
+    slot->fetched_at = record->fetched_at;
+    cache->live_bytes += record_size(url_len, record->etag_len, record->body_len);
+}
+
+
+/* index every complete record. a record cut short by a crash ends the log, and gets dropped */
+static int scan_log(struct http_cache* cache, size_t size) {
+    char* map = mmap(NULL, size, PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+
+    uint64_t offset = sizeof(struct http_cache_file_header);
+    while (offset + sizeof(struct http_cache_record) <= size) {
+        struct http_cache_record record;
+        memcpy(&record, map + offset, sizeof(record));
+        uint64_t next = offset + record_size(record.url_len, record.etag_len, record.body_len);
+        if (next > size) break;
+
+        index_record(cache, map + offset + sizeof(record), record.url_len, offset, &record);
+        offset = next;
+    }
+    munmap(map, size);
+
+    if (offset < size && ftruncate(cache->fd, offset) != 0) perror("ftruncate");
+    cache->end = offset;
+    return 1;
+}
+
+
+/* open `path` with a shared lock on OPEN_LOCK. a closing process may have compacted the file and
+ * renamed a new one over it while we waited for the lock, so make sure it's still the same file */
+static int open_locked(const char* path) {
+    for (;;) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            perror(path);
+            return -1;
+        }
+        range_lock(fd, F_RDLCK, OPEN_LOCK, 1);
+
+        struct stat opened, named;
+        if (fstat(fd, &opened) != 0 || stat(path, &named) != 0
+            || (opened.st_ino == named.st_ino && opened.st_dev == named.st_dev)) return fd;
+        close(fd);
+    }
+}
+
+
+struct http_cache* http_cache_open(const char* path, double ttl_seconds) {
+    int fd = open_locked(path);
+    if (fd < 0) return NULL;
+
+    struct http_cache* cache = calloc(1, sizeof(struct http_cache));
+    cache->path = strdup(path);
+    cache->fd = fd;
+    cache->ttl = ttl_seconds > 0 ? ttl_seconds : DEFAULT_HTTP_CACHE_TTL;
+    pthread_mutex_init(&cache->mutex, NULL);
+    grow_index(cache);
+
+    range_lock(fd, F_WRLCK, APPEND_LOCK, 1);
+
+    /* whoever gets here first writes the header */
+    struct http_cache_file_header header = {0};
+    struct stat st;
+    int valid = fstat(fd, &st) == 0;
+    if (valid && st.st_size == 0) {
+        memcpy(header.magic, HTTP_CACHE_MAGIC, sizeof(header.magic));
+        header.version = HTTP_CACHE_VERSION;
+        valid = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+        st.st_size = sizeof(header);
+    } else if (valid) {
+        valid = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+             && memcmp(header.magic, HTTP_CACHE_MAGIC, sizeof(header.magic)) == 0
+             && header.version == HTTP_CACHE_VERSION;
+    }
+    if (valid) valid = scan_log(cache, st.st_size);
+
+    range_lock(fd, F_UNLCK, APPEND_LOCK, 0);
+
+    if (!valid) {
+        fprintf(stderr, "%s: not a version %d response cache\n", path, HTTP_CACHE_VERSION);
+        close(fd);
+        cache->fd = -1;
+        http_cache_close(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+
+/* rewrite the log with only the records the index points at */
+static void compact(struct http_cache* cache) {
+    size_t tmp_size = strlen(cache->path) + sizeof(".tmp");
+    char* tmp_path = malloc(tmp_size);
+    snprintf(tmp_path, tmp_size, "%s.tmp", cache->path);
+
+    FILE* out = fopen(tmp_path, "wb");
+    if (out == NULL) {
+        perror(tmp_path);
+        free(tmp_path);
+        return;
+    }
+
+    struct http_cache_file_header header = {0};
+    memcpy(header.magic, HTTP_CACHE_MAGIC, sizeof(header.magic));
+    header.version = HTTP_CACHE_VERSION;
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+    char* buffer = NULL;
+    for (size_t i = 0; ok && i < cache->capacity; i++) {
+        const struct index_entry* entry = &cache->entries[i];
+        if (entry->url == NULL) continue;
+
+        uint64_t size = record_size(strlen(entry->url), entry->etag_len, entry->body_len);
+        buffer = realloc(buffer, size);
+        ok = pread(cache->fd, buffer, size, entry->offset) == (ssize_t)size && fwrite(buffer, size, 1, out) == 1;
+    }
+    free(buffer);
+
+    ok = fflush(out) == 0 && fsync(fileno(out)) == 0 && ok;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmp_path, cache->path) != 0) {
+        perror(tmp_path);
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+}
+
+
+void http_cache_close(struct http_cache* cache) {
+    if (cache == NULL) return;
+
+    /* compact when most of the file is dead, and only when nobody else could be reading it.
+     * other processes may have appended since we opened it, so take a fresh look first */
+    struct stat st;
+    if (cache->fd >= 0 && range_lock(cache->fd, F_WRLCK, OPEN_LOCK, 0) == 0 && fstat(cache->fd, &st) == 0) {
+        clear_index(cache);
+        if (scan_log(cache, st.st_size)) {
+            uint64_t dead = cache->end - sizeof(struct http_cache_file_header) - cache->live_bytes;
+            if (dead > cache->live_bytes) compact(cache);
+        }
+    }
+    if (cache->fd >= 0) close(cache->fd);
+
+    clear_index(cache);
+    free(cache->entries);
+    free(cache->path);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+
+int http_cache_lookup(struct http_cache* cache, const char* url, struct cached_response* response) {
+    *response = (struct cached_response){0};
+
+    pthread_mutex_lock(&cache->mutex);
+    struct index_entry entry = *find_slot(cache, url);
+    pthread_mutex_unlock(&cache->mutex);
+    if (entry.url == NULL) return 0;
+
+    /* records never move while the file is open, so reading needs no lock */
+    uint64_t offset = entry.offset + sizeof(struct http_cache_record) + strlen(url);
+    char* etag = entry.etag_len ? malloc(entry.etag_len + 1) : NULL;
+    char* body = malloc(entry.body_len + 1);
+    if ((etag && pread(cache->fd, etag, entry.etag_len, offset) != (ssize_t)entry.etag_len)
+        || pread(cache->fd, body, entry.body_len, offset + entry.etag_len) != (ssize_t)entry.body_len) {
+        free(etag);
+        free(body);
+        return 0;
+    }
+    if (etag) etag[entry.etag_len] = '\0';
+    body[entry.body_len] = '\0';
+
+    response->body = body;
+    response->size = entry.body_len;
+    response->etag = etag;
+    response->stale = difftime(time(NULL), (time_t)entry.fetched_at) > cache->ttl;
+    return 1;
+}
+
+
+void cached_response_free(struct cached_response* response) {
+    free(response->body);
+    free(response->etag);
+    *response = (struct cached_response){0};
+}
+
+
+void http_cache_store(struct http_cache* cache, const char* url, const char* etag, const char* body, size_t size) {
+    struct http_cache_record record = {
+        .url_len = strlen(url),
+        .etag_len = etag ? strlen(etag) : 0,
+        .body_len = size,
+        .fetched_at = (int64_t)time(NULL)
+    };
+    if (size > UINT32_MAX) return;
+
+    /* one write per record, so a crash leaves at most one incomplete record at the end */
+    uint64_t total = record_size(record.url_len, record.etag_len, record.body_len);
+    char* buffer = malloc(total);
+    char* p = buffer;
+    memcpy(p, &record, sizeof(record)); p += sizeof(record);
+    memcpy(p, url, record.url_len); p += record.url_len;
+    if (etag) memcpy(p, etag, record.etag_len);
+    p += record.etag_len;
+    memcpy(p, body, size);
+
+    pthread_mutex_lock(&cache->mutex);
+    range_lock(cache->fd, F_WRLCK, APPEND_LOCK, 1);
+
+    /* other processes append too. their records are skipped, not indexed, until the next open */
+    struct stat st;
+    uint64_t offset = fstat(cache->fd, &st) == 0 ? (uint64_t)st.st_size : cache->end;
+    if (pwrite(cache->fd, buffer, total, offset) == (ssize_t)total) {
+        index_record(cache, url, record.url_len, offset, &record);
+        cache->end = offset + total;
+    } else {
+        perror(cache->path);
+    }
+
+    range_lock(cache->fd, F_UNLCK, APPEND_LOCK, 0);
+    pthread_mutex_unlock(&cache->mutex);
+    free(buffer);
+}
+
+
+void http_cache_touch(struct http_cache* cache, const char* url) {
+    int64_t now = (int64_t)time(NULL);
+
+    pthread_mutex_lock(&cache->mutex);
+    struct index_entry* entry = find_slot(cache, url);
+    if (entry->url) {
+        entry->fetched_at = now;
+        if (pwrite(cache->fd, &now, sizeof(now), entry->offset + offsetof(struct http_cache_record, fetched_at)) != sizeof(now)) {
+            perror(cache->path);
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
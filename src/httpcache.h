@@ -0,0 +1,39 @@
+#ifndef   __HTTPCACHE_H__
+#define   __HTTPCACHE_H__
+
+#include <stddef.h>
+
+/* responses younger than this are served without asking unless told otherwise */
+#define DEFAULT_HTTP_CACHE_TTL (60 * 60)
+
+/* persistent cache of API responses, keyed by request URL. the file is an append-only log of
+ * (url, ETag, body) records. an in-memory index of the newest record per URL is rebuilt by
+ * scanning it on open, and bodies are only read back when asked for. records superseded by newer
+ * ones are dropped when the file is compacted on close, if nobody else has it open.
+ * safe to use from any number of threads, and processes can share a file */
+struct http_cache;
+
+/* open or create the cache at `path`. `ttl_seconds` <= 0 picks DEFAULT_HTTP_CACHE_TTL.
+ * returns NULL if the file can't be used */
+struct http_cache* http_cache_open(const char* path, double ttl_seconds);
+void http_cache_close(struct http_cache* cache);
+
+/* a cached response */
+struct cached_response {
+    char* body;   /* NUL-terminated, to be freed */
+    size_t size;
+    char* etag;   /* to be freed, NULL if the server didn't send one */
+    int stale;    /* past its TTL. wants revalidating before it's used */
+};
+
+/* the cached response to `url`. returns 0 if there is none */
+int http_cache_lookup(struct http_cache* cache, const char* url, struct cached_response* response);
+void cached_response_free(struct cached_response* response);
+
+/* remember `body` as the response to `url`, as of now. `etag` may be NULL */
+void http_cache_store(struct http_cache* cache, const char* url, const char* etag, const char* body, size_t size);
+
+/* the server confirmed the cached response to `url` is still current. it's fresh again */
+void http_cache_touch(struct http_cache* cache, const char* url);
+
+#endif /* __HTTPCACHE_H__ */
@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "strset.h"
+
+/* starting number of slots */
+#define INTERN_INITIAL_CAPACITY 64
+
+
+void intern_init(struct intern_table* table) {
+    table->slots = calloc(INTERN_INITIAL_CAPACITY, sizeof(int));
+    table->capacity = INTERN_INITIAL_CAPACITY;
+    table->strings = NULL;
+    table->count = table->strings_capacity = 0;
+}
+
+
+void intern_free(struct intern_table* table) {
+    for (size_t i = 0; i < table->count; i++) free(table->strings[i]);
+    free(table->strings);
+    free(table->slots);
+    *table = (struct intern_table){0};
+}
+
+
+/* slot holding `key`, or the empty slot it would go into */
+static size_t find_slot(const struct intern_table* table, int* slots, size_t capacity, const char* key) {
+    size_t i = strset_hash(key) & (capacity - 1);
+    while (slots[i] != 0 && strcmp(table->strings[slots[i] - 1], key) != 0) i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+
+/* double the table. strings stay where they are, only ids move */
+static void grow(struct intern_table* table) {
+    size_t capacity = table->capacity * 2;
+    int* slots = calloc(capacity, sizeof(int));
+
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i] == 0) continue;
+        slots[find_slot(table, slots, capacity, table->strings[table->slots[i] - 1])] = table->slots[i];
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+
+int intern_find(const struct intern_table* table, const char* key) {
+    return table->slots[find_slot(table, table->slots, table->capacity, key)] - 1;
+}
+
+
+int intern_add(struct intern_table* table, const char* key) {
+    /* keep the load factor under 3/4 */
+    if ((table->count + 1) * 4 > table->capacity * 3) grow(table);
+
+    size_t i = find_slot(table, table->slots, table->capacity, key);
+    if (table->slots[i] != 0) return table->slots[i] - 1;
+
+    if (table->count == table->strings_capacity) {
+        table->strings_capacity = table->strings_capacity ? table->strings_capacity * 2 : 64;
+        table->strings = realloc(table->strings, table->strings_capacity * sizeof(char*));
+    }
+    table->strings[table->count] = strdup(key);
+    table->slots[i] = (int)++table->count;
+    return table->slots[i] - 1;
+}
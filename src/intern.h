@@ -0,0 +1,30 @@
+#ifndef   __INTERN_H__
+#define   __INTERN_H__
+
+#include <stddef.h>
+
+/* interns strings into dense ids 0, 1, 2, ... in the order they are first seen.
+ * keys are copied in. not thread-safe */
+struct intern_table {
+    int* slots;       /* id + 1 of the string in each slot, 0 if empty */
+    size_t capacity;  /* always a power of two */
+    char** strings;   /* indexed by id */
+    size_t count;
+    size_t strings_capacity;
+};
+
+void intern_init(struct intern_table* table);
+void intern_free(struct intern_table* table);
+
+/* id of `key`, -1 if it was never added */
+int intern_find(const struct intern_table* table, const char* key);
+
+/* id of `key`, adding it if it's new */
+int intern_add(struct intern_table* table, const char* key);
+
+/* the string behind `id` */
+static inline const char* intern_string(const struct intern_table* table, int id) {
+    return table->strings[id];
+}
+
+#endif /* __INTERN_H__ */
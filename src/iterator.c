@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "iterator.h"
+
+/* quotes that may pile up between the crawl and whoever pulls them */
+#define ITERATOR_RING_CAPACITY 4096
+
+struct crawl_iterator {
+    struct crawler* crawler;
+    struct crawler_config saved_config; /* what to put back once we're done */
+    struct crawl_sink* sinks;           /* the crawler's sinks plus our own */
+
+    const char** root_uris;
+    int roots_count;
+    int threads;
+
+    struct result_ring ring;
+    struct crawl_summary summary;
+    int truncated;
+    pthread_t thread;
+};
+
+
+/* our sink: copy every result into the ring. this is where it stops being borrowed */
+static void push_result(void* userdata, const struct quote_result* result) {
+    struct crawl_iterator* it = userdata;
+    result_ring_push(&it->ring, (struct result_record){
+        .uri = strdup(result->uri),
+        .parent_uri = strdup(result->parent_uri),
+        .author_did = result->author_did ? strdup(result->author_did) : NULL,
+        .depth = result->depth,
+        .quote_count = result->quote_count
+    });
+}
+
+
+static void keep_summary(void* userdata, const struct crawl_summary* summary) {
+    struct crawl_iterator* it = userdata;
+    it->summary = *summary;
+}
+
+
+static void* crawl_thread(void* arg) {
+    struct crawl_iterator* it = arg;
+
+    if (it->threads > 0 || it->roots_count > 1) {
+        it->truncated = parallel_quote_search(it->crawler, it->root_uris, it->roots_count, it->threads,
+                                              NULL, NULL, NULL, NULL);
+    } else {
+        /* at://<did>/app.bsky.feed.post/<post_id> */
+        const char* uri = it->root_uris[0];
+        const char* did = strstr(uri, "://");
+        const char* did_end = did ? strchr(did + 3, '/') : NULL;
+        const char* post_id = strrchr(uri, '/');
+
+        if (did_end && post_id) {
+            char* actor_did = strndup(did + 3, did_end - (did + 3));
+            it->truncated = recursive_quote_search(it->crawler, actor_did, post_id + 1, NULL, NULL, NULL, NULL);
+            free(actor_did);
+        } else {
+            fprintf(stderr, "not a post AT-URI: %s\n", uri);
+        }
+    }
+
+    /* lets the consumer drain what's left and stop */
+    result_ring_close(&it->ring);
+    return NULL;
+}
+
+
+struct crawl_iterator* crawl_iterator_start(struct crawler* crawler, const char** root_uris, int roots_count, int threads) {
+    struct crawl_iterator* it = calloc(1, sizeof(struct crawl_iterator));
+    it->crawler = crawler;
+    it->root_uris = root_uris;
+    it->roots_count = roots_count;
+    it->threads = threads;
+    it->saved_config = *crawler_get_config(crawler);
+    result_ring_init(&it->ring, ITERATOR_RING_CAPACITY);
+
+    /* run with the crawler's sinks plus one feeding our ring */
+    struct crawler_config config = it->saved_config;
+    it->sinks = calloc(config.sinks_count + 1, sizeof(struct crawl_sink));
+    if (config.sinks_count > 0) memcpy(it->sinks, config.sinks, config.sinks_count * sizeof(struct crawl_sink));
+    it->sinks[config.sinks_count] = (struct crawl_sink){
+        .on_result = push_result,
+        .on_complete = keep_summary,
+        .userdata = it
+    };
+    config.sinks = it->sinks;
+    config.sinks_count++;
+    crawler_set_config(crawler, &config);
+
+    if (pthread_create(&it->thread, NULL, crawl_thread, it) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        crawler_set_config(crawler, &it->saved_config);
+        result_ring_destroy(&it->ring);
+        free(it->sinks);
+        free(it);
+        return NULL;
+    }
+    return it;
+}
+
+
+int crawl_iterator_next(struct crawl_iterator* it, struct result_record* record) {
+    return result_ring_pop(&it->ring, record);
+}
+
+
+int crawl_iterator_finish(struct crawl_iterator* it, struct crawl_summary* summary) {
+    /* a crawl blocked on a full ring would never end. keep draining until it does */
+    struct result_record record;
+    while (result_ring_pop(&it->ring, &record)) result_record_free(&record);
+    pthread_join(it->thread, NULL);
+
+    crawler_set_config(it->crawler, &it->saved_config);
+    if (summary) *summary = it->summary;
+    int truncated = it->truncated;
+
+    result_ring_destroy(&it->ring);
+    free(it->sinks);
+    free(it);
+    return truncated;
+}
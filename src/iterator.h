@@ -0,0 +1,24 @@
+#ifndef   __ITERATOR_H__
+#define   __ITERATOR_H__
+
+#include "crawler.h"
+#include "ring.h"
+
+/* pull-style access to a crawl: the crawl runs on a background thread and every quote it finds
+ * can be taken with crawl_iterator_next() as soon as it's found */
+struct crawl_iterator;
+
+/* start crawling `roots_count` roots (AT-URIs). a single root with `threads` 0 runs the pipelined
+ * crawl, anything else runs worker mode with `threads` workers. the crawler's own sinks keep
+ * getting fed. the crawler must not be used for anything else until crawl_iterator_finish() */
+struct crawl_iterator* crawl_iterator_start(struct crawler* crawler, const char** root_uris, int roots_count, int threads);
+
+/* next quote in the order it was found, blocking until there is one. returns 0 once the crawl is
+ * over and everything was taken. the caller owns the record (see result_record_free()) */
+int crawl_iterator_next(struct crawl_iterator* it, struct result_record* record);
+
+/* wait for the crawl to end, drop whatever wasn't taken, free the iterator and restore the
+ * crawler's config. `summary` may be NULL. returns 1 if the result is partial, 0 otherwise */
+int crawl_iterator_finish(struct crawl_iterator* it, struct crawl_summary* summary);
+
+#endif /* __ITERATOR_H__ */
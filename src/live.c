@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "live.h"
+
+struct live_segment {
+    char* name;
+    struct live_header* header;
+    size_t size;
+    char* log;
+};
+
+
+static void futex_wake_all(atomic_uint* word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+
+struct live_segment* live_segment_create(const char* name, size_t capacity) {
+    if (capacity == 0) capacity = DEFAULT_LIVE_CAPACITY;
+    capacity = align8(capacity);
+    size_t size = sizeof(struct live_header) + capacity;
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        perror(name);
+        return NULL;
+    }
+    if (ftruncate(fd, size) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(name);
+        return NULL;
+    }
+
+    /* the segment starts out zeroed, so only the constant fields need filling in */
+    struct live_segment* segment = calloc(1, sizeof(struct live_segment));
+    segment->name = strdup(name);
+    segment->header = map;
+    segment->size = size;
+    segment->log = (char*)map + sizeof(struct live_header);
+
+    memcpy(segment->header->magic, LIVE_MAGIC, sizeof(segment->header->magic));
+    segment->header->version = LIVE_VERSION;
+    segment->header->capacity = capacity;
+    return segment;
+}
+
+
+void live_segment_destroy(struct live_segment* segment, int unlink) {
+    munmap(segment->header, segment->size);
+    if (unlink) shm_unlink(segment->name);
+    free(segment->name);
+    free(segment);
+}
+
+
+/* `seq` moved. only costs a syscall if somebody is actually asleep on it */
+static void publish(struct live_header* header) {
+    atomic_fetch_add(&header->seq, 1);
+    if (atomic_load(&header->waiters) > 0) futex_wake_all(&header->seq);
+}
+
+
+static void publish_result(void* userdata, const struct quote_result* result) {
+    struct live_segment* segment = userdata;
+    struct live_header* header = segment->header;
+
+    size_t uri_len = strlen(result->uri);
+    size_t parent_uri_len = strlen(result->parent_uri);
+    size_t author_len = result->author_did ? strlen(result->author_did) : 0;
+    size_t size = align8(sizeof(struct live_record) + uri_len + parent_uri_len + author_len + 3);
+
+    /* only we move `end`, a relaxed load is enough */
+    uint64_t end = atomic_load_explicit(&header->end, memory_order_relaxed);
+    if (uri_len > UINT16_MAX || parent_uri_len > UINT16_MAX || author_len > UINT16_MAX
+        || end + size > header->capacity) {
+        atomic_fetch_or(&header->flags, LIVE_FULL);
+        atomic_fetch_add(&header->dropped, 1);
+        return;
+    }
+
+    struct live_record* record = (struct live_record*)(segment->log + end);
+    record->size = size;
+    record->depth = result->depth;
+    record->quote_count = result->quote_count;
+    record->uri_len = uri_len;
+    record->parent_uri_len = parent_uri_len;
+    record->author_len = author_len;
+
+    char* strings = record->strings;
+    memcpy(strings, result->uri, uri_len + 1);
+    memcpy(strings + uri_len + 1, result->parent_uri, parent_uri_len + 1);
+    strings[uri_len + 1 + parent_uri_len + 1] = '\0';
+    if (result->author_did) memcpy(strings + uri_len + 1 + parent_uri_len + 1, result->author_did, author_len + 1);
+
+    /* the record is complete before readers can see it */
+    atomic_store_explicit(&header->end, end + size, memory_order_release);
+    publish(header);
+}
+
+
+/* one crawl is over. more may follow into the same segment (-W), so this isn't LIVE_DONE yet */
+static void publish_summary(void* userdata, const struct crawl_summary* summary) {
+    struct live_segment* segment = userdata;
+    if (summary->truncated) atomic_fetch_or(&segment->header->flags, LIVE_TRUNCATED);
+    publish(segment->header);
+}
+
+
+void live_segment_finish(struct live_segment* segment) {
+    atomic_fetch_or(&segment->header->flags, LIVE_DONE);
+    publish(segment->header);
+}
+
+
+struct crawl_sink live_segment_sink(struct live_segment* segment) {
+    return (struct crawl_sink){
+        .on_result = publish_result,
+        .on_complete = publish_summary,
+        .userdata = segment
+    };
+}
+
+
+int live_reader_open(const char* name, struct live_reader* reader) {
+    *reader = (struct live_reader){0};
+
+    /* read-write only for `waiters`. readers never touch anything else */
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror(name);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct live_header)) {
+        fprintf(stderr, "%s: not a live segment\n", name);
+        close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+
+    struct live_header* header = map;
+    if (memcmp(header->magic, LIVE_MAGIC, sizeof(header->magic)) != 0 || header->version != LIVE_VERSION
+        || header->capacity > st.st_size - sizeof(struct live_header)) {
+        fprintf(stderr, "%s: not a version %d live segment\n", name, LIVE_VERSION);
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    reader->header = header;
+    reader->size = st.st_size;
+    reader->log = (const char*)map + sizeof(struct live_header);
+    return 1;
+}
+
+
+void live_reader_close(struct live_reader* reader) {
+    if (reader->header) munmap(reader->header, reader->size);
+    *reader = (struct live_reader){0};
+}
+
+
+const struct live_record* live_reader_next(struct live_reader* reader) {
+    uint64_t end = atomic_load_explicit(&reader->header->end, memory_order_acquire);
+    if (reader->offset >= end) return NULL;
+
+    const struct live_record* record = (const struct live_record*)(reader->log + reader->offset);
+    reader->offset += record->size;
+    return record;
+}
+
+
+void live_reader_wait(struct live_reader* reader, unsigned int seq, int timeout_ms) {
+    struct live_header* header = reader->header;
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+
+    /* announce ourselves before checking, so the publisher can't bump seq unseen and skip the wake */
+    atomic_fetch_add(&header->waiters, 1);
+    if (atomic_load(&header->seq) == seq) {
+        syscall(SYS_futex, &header->seq, FUTEX_WAIT, seq, timeout_ms < 0 ? NULL : &timeout, NULL, 0);
+    }
+    atomic_fetch_sub(&header->waiters, 1);
+}
@@ -0,0 +1,105 @@
+#ifndef   __LIVE_H__
+#define   __LIVE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "crawler.h"
+
+/*
+ * publishes a running crawl into a POSIX shared memory segment so other processes (a GUI, a
+ * monitor) can follow it without copies or sockets. the segment is a header followed by an
+ * append-only log of records:
+ *
+ * - a record is written completely before `end` moves past it, so everything below `end` can be
+ *   read without locking.
+ * - `seq` counts published records. it's also a futex word: readers sleep on it until it changes.
+ * - the log never wraps. once it's full later results are only counted in `dropped`.
+ */
+
+#define LIVE_MAGIC   "QCLIVE\0\0"
+#define LIVE_VERSION 1
+
+/* default log size */
+#define DEFAULT_LIVE_CAPACITY (64 << 20)
+
+/* header flags */
+#define LIVE_DONE      1 /* the publisher is done, nothing more will be published */
+#define LIVE_TRUNCATED 2 /* a crawl stopped early */
+#define LIVE_FULL      4 /* the log ran out of room, see `dropped` */
+
+struct live_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t capacity;     /* bytes of log after the header */
+    _Atomic uint64_t end;  /* bytes of log that are published */
+    atomic_uint seq;       /* records published. futex word */
+    atomic_uint waiters;   /* readers sleeping on `seq` */
+    atomic_uint flags;
+    atomic_uint dropped;   /* results that didn't fit */
+};
+
+/* one result. the three strings follow the fixed part, each NUL-terminated */
+struct live_record {
+    uint32_t size;       /* of the whole record, padding included. the next one starts right after */
+    int32_t depth;
+    int32_t quote_count; /* -1 if unknown */
+    uint16_t uri_len;
+    uint16_t parent_uri_len;
+    uint16_t author_len; /* 0 if unknown */
+    char strings[];
+};
+
+static inline const char* live_record_uri(const struct live_record* record) {
+    return record->strings;
+}
+
+static inline const char* live_record_parent_uri(const struct live_record* record) {
+    return record->strings + record->uri_len + 1;
+}
+
+static inline const char* live_record_author(const struct live_record* record) {
+    return record->strings + record->uri_len + 1 + record->parent_uri_len + 1;
+}
+
+
+/* publishing side */
+struct live_segment;
+
+/* create the segment `name` (like "/quotecrawler") with room for `capacity` bytes of records.
+ * <= 0 picks DEFAULT_LIVE_CAPACITY. an old segment with the same name is replaced */
+struct live_segment* live_segment_create(const char* name, size_t capacity);
+
+/* unmap the segment. `unlink` removes the name too. readers that have it open keep their view */
+void live_segment_destroy(struct live_segment* segment, int unlink);
+
+/* a sink publishing into the segment. callbacks must not run concurrently, which the crawler
+ * guarantees. the end of each crawl wakes readers, but the segment can take more crawls after it */
+struct crawl_sink live_segment_sink(struct live_segment* segment);
+
+/* publish LIVE_DONE, once nothing will be crawled into the segment anymore */
+void live_segment_finish(struct live_segment* segment);
+
+
+/* reading side, for other processes */
+struct live_reader {
+    struct live_header* header;
+    size_t size;
+    const char* log;
+    uint64_t offset; /* where the next record starts */
+};
+
+/* open the segment `name`. returns 0 if it doesn't exist or isn't a live segment */
+int live_reader_open(const char* name, struct live_reader* reader);
+void live_reader_close(struct live_reader* reader);
+
+/* next published record, NULL if the reader has seen everything published so far */
+const struct live_record* live_reader_next(struct live_reader* reader);
+
+/* sleep until something gets published after `seq`, or `timeout_ms` passes (-1 waits forever).
+ * pass the value of header->seq read before draining with live_reader_next() */
+void live_reader_wait(struct live_reader* reader, unsigned int seq, int timeout_ms);
+
+#endif /* __LIVE_H__ */
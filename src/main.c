@@ -1,94 +1,590 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
+#include <string.h>
 #include <unistd.h>
+#include <signal.h>
+#include <time.h>
 
 #include "crawler.h"
+#include "estimate.h"
+#include "iterator.h"
+#include "writer.h"
+#include "snapshot.h"
+#include "snapdiff.h"
+#include "database.h"
+#include "live.h"
+#include "timeline.h"
+#include "aggregate.h"
+#include "didcache.h"
+#include "handles.h"
+#include "httpcache.h"
+#include "watch.h"
 
 /* placeholder url */
 #define POST_URL "https://bsky.app/profile/raysan5.bsky.social/post/3le4og7pvh22w"
 
-struct quote_search_params {
-    const char* actor_did;
-    const char* post_id;
-    char** visited;
-    int visited_count;
-    char** all_quotes;
-    int all_quotes_count;
-};
+/* with -N, links wait until this many of their authors need looking up, so lookups go out
+ * in full getProfiles batches */
+#define RESOLVE_BATCH 100
+
+/* with -W, quiet posts are polled at least this often unless told otherwise */
+#define DEFAULT_WATCH_MAX_INTERVAL 3600
 
-struct quote_search_params qsp;
+struct crawler* crawler;
 
-pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-int is_thread_running = 1;
-int new_quote_available = 0;
+/* DID -> handle for readable links, NULL if links keep the DID */
+struct handle_resolver* resolver;
 
-void signal_main_thread(void) {
-    pthread_mutex_lock(&mutex);
-    new_quote_available = 1;
-    pthread_mutex_unlock(&mutex);
+/* links waiting for their author's handle */
+char** held_uris;
+size_t held_count;
+size_t held_capacity;
+
+char* quote_link(const char* uri) {
+    return resolver ? handle_resolver_link(resolver, uri) : post_uri_to_https(uri);
+}
+
+/* print every held link, looking up what's still missing first */
+void flush_quotes(void) {
+    if (resolver) handle_resolver_resolve(resolver, crawler);
+    for (size_t i = 0; i < held_count; i++) {
+        char* https = quote_link(held_uris[i]);
+        printf("%s\n", https);
+        free(https);
+        free(held_uris[i]);
+    }
+    held_count = 0;
 }
 
-void print_last_quote(struct quote_search_params *qsp) {
-    if (qsp->all_quotes_count > 0) {
-        char* https = post_uri_to_https(qsp->all_quotes[qsp->all_quotes_count - 1]);
+void print_quote(const char* uri) {
+    if (resolver == NULL) {
+        char* https = post_uri_to_https(uri);
         printf("%s\n", https);
         free(https);
+        return;
+    }
+
+    char* did = get_did_from_uri(uri);
+    handle_resolver_add(resolver, did);
+    free(did);
+
+    if (held_count == held_capacity) {
+        held_capacity = held_capacity ? held_capacity * 2 : 256;
+        held_uris = realloc(held_uris, held_capacity * sizeof(char*));
     }
-    new_quote_available = 0;
+    held_uris[held_count++] = strdup(uri);
+    if (handle_resolver_pending(resolver) >= RESOLVE_BATCH) flush_quotes();
 }
 
-void* init_recursive_quote_search(void* arg) {
-    struct quote_search_params* qsp = arg;
 
-    recursive_quote_search(qsp->actor_did, qsp->post_id, &qsp->visited,
-                          &qsp->visited_count, &qsp->all_quotes, &qsp->all_quotes_count);
+/* one line per bucket: when it starts (UTC) and how many quotes were posted in it */
+void print_histogram(const struct timeline* timeline, double bucket_seconds) {
+    struct time_histogram histogram;
+    timeline_histogram(timeline, bucket_seconds, &histogram);
 
-    pthread_mutex_lock(&mutex);
-    is_thread_running = 0;
-    pthread_mutex_unlock(&mutex);
-    return NULL;
+    for (int i = 0; i < histogram.buckets; i++) {
+        time_t start = (time_t)((histogram.start + i * histogram.bucket) / 1000000);
+        char when[32];
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&start));
+        printf("%s %d\n", when, histogram.counts[i]);
+    }
+    if (histogram.undated > 0) printf("undated %d\n", histogram.undated);
+
+    time_histogram_free(&histogram);
 }
 
 
-int main(void) {
-    shared_curl_init();
+void print_top(struct aggregator* aggregator, int k) {
+    static const char* TITLES[POST_METRICS] = { "most quoted", "most liked" };
 
-    const char* actor = get_actor(POST_URL);
-    qsp = (struct quote_search_params){
-        .actor_did = get_did(actor),
-        .post_id = extract_post_id(POST_URL),
-        .visited = NULL,
-        .visited_count = 0,
-        .all_quotes = NULL,
-        .all_quotes_count = 0
-    };
-
-    pthread_t quote_search_thread;
-    if (pthread_create(&quote_search_thread, NULL, init_recursive_quote_search, &qsp) != 0) {
-        fprintf(stderr, "Failed to create thread\n");
+    for (int m = 0; m < POST_METRICS; m++) {
+        struct ranked_post* posts;
+        int count = aggregator_top_posts(aggregator, (enum post_metric)m, &posts);
+        printf("%s:\n", TITLES[m]);
+        for (int i = 0; i < count && resolver; i++) {
+            char* did = get_did_from_uri(posts[i].uri);
+            handle_resolver_add(resolver, did);
+            free(did);
+        }
+        if (resolver) handle_resolver_resolve(resolver, crawler);
+        for (int i = 0; i < count; i++) {
+            char* https = quote_link(posts[i].uri);
+            printf("  %d %s\n", posts[i].score, https);
+            free(https);
+        }
+        ranked_posts_free(posts, count);
+    }
+
+    struct ranked_author* authors;
+    int count = aggregator_top_authors(aggregator, k, &authors);
+    printf("most active authors:\n");
+    for (int i = 0; i < count && resolver; i++) handle_resolver_add(resolver, authors[i].did);
+    if (resolver) handle_resolver_resolve(resolver, crawler);
+    for (int i = 0; i < count; i++) {
+        const char* handle = resolver ? handle_resolver_get(resolver, authors[i].did) : NULL;
+        printf("  %d %s (%lld quotes, %lld likes received)\n", authors[i].quotes, handle ? handle : authors[i].did,
+               authors[i].quotes_received, authors[i].likes_received);
+    }
+    ranked_authors_free(authors, count);
+}
+
+
+/* where the crawl's memory went. stderr, so it stays out of the data */
+void print_memory(void) {
+    static const char* SUBSYSTEMS[MEMORY_SUBSYSTEMS] = { "frontier", "dedupe", "results", "responses", "json" };
+
+    struct memory_usage usage[MEMORY_SUBSYSTEMS];
+    crawler_get_memory(crawler, usage);
+    fprintf(stderr, "%-10s %12s %12s %12s %12s\n", "memory", "live", "peak", "allocations", "frees");
+    for (int i = 0; i < MEMORY_SUBSYSTEMS; i++) {
+        fprintf(stderr, "%-10s %12zu %12zu %12zu %12zu\n", SUBSYSTEMS[i], usage[i].live, usage[i].peak,
+                usage[i].allocations, usage[i].frees);
+    }
+}
+
+
+/* one line per difference: + added, - removed, ~ changed */
+void print_change(void* userdata, const struct post_change* change) {
+    const struct snapshot* snapshots = userdata; /* old, new */
+    const struct snapshot* snapshot = change->new_row >= 0 ? &snapshots[1] : &snapshots[0];
+    size_t row = change->new_row >= 0 ? change->new_row : change->old_row;
+
+    char* uri = snapshot_uri(snapshot, row);
+    char* https = uri ? post_uri_to_https(uri) : NULL;
+    const char* link = https ? https : snapshot_author(snapshot, row);
+
+    if (change->old_row < 0) {
+        printf("+ %s\n", link);
+    } else if (change->new_row < 0) {
+        printf("- %s\n", link);
+    } else {
+        printf("~ %s%s", link, change->parent_changed ? " moved" : "");
+        if (change->quote_count_delta != 0) printf(" quotes %+d", change->quote_count_delta);
+        printf("\n");
+    }
+    free(https);
+    free(uri);
+}
+
+
+/* compare two snapshot files. returns the exit status */
+int diff_snapshots(const char* old_path, const char* new_path) {
+    struct snapshot snapshots[2];
+    if (!snapshot_open(old_path, &snapshots[0])) return 1;
+    if (!snapshot_open(new_path, &snapshots[1])) {
+        snapshot_close(&snapshots[0]);
         return 1;
     }
 
-    while (is_thread_running) {
-        pthread_mutex_lock(&mutex);
-        if (new_quote_available) print_last_quote(&qsp);
-        pthread_mutex_unlock(&mutex);
+    struct snapshot_diff_summary summary;
+    snapshot_diff(&snapshots[0], &snapshots[1], print_change, snapshots, &summary);
+    printf("%zu added, %zu removed, %zu changed, %zu edges added, %zu edges removed, quotes %+lld\n",
+           summary.added, summary.removed, summary.changed, summary.edges_added, summary.edges_removed,
+           summary.quote_count_delta);
+
+    snapshot_close(&snapshots[0]);
+    snapshot_close(&snapshots[1]);
+    return 0;
+}
+
+
+/* -W: the quotes found so far under every watched root, so a new crawl only hands out what's new */
+struct watched_root {
+    const char* uri;
+    char* actor_did;
+    char* post_id;
+    char** quotes;
+    int quotes_count;
+};
+
+struct watch {
+    struct watched_root* roots;
+    int threads;     /* as with -j */
+    int print_links; /* links aren't going anywhere else, like with -f or -O */
+};
+
+struct watcher* watcher;
+
+
+/* a root's quoteCount grew: crawl it again, skipping every quote we already know */
+void on_growth(void* userdata, int id, const char* uri, int old_count, int new_count) {
+    struct watch* watch = userdata;
+    struct watched_root* root = &watch->roots[id];
+    (void)uri;
 
-        usleep(1000);
+    int known = root->quotes_count;
+    int truncated = watch->threads > 0
+        ? parallel_quote_search(crawler, &root->uri, 1, watch->threads, NULL, NULL, &root->quotes, &root->quotes_count)
+        : recursive_quote_search(crawler, root->actor_did, root->post_id, NULL, NULL, &root->quotes, &root->quotes_count);
+    if (watch->print_links) {
+        for (int i = known; i < root->quotes_count; i++) print_quote(root->quotes[i]);
+        flush_quotes();
     }
 
-    pthread_join(quote_search_thread, NULL);
+    if (old_count < 0) fprintf(stderr, "%s: %d quotes\n", root->post_id, new_count);
+    else fprintf(stderr, "%s: %d -> %d quotes, %d new%s\n", root->post_id, old_count, new_count,
+                 root->quotes_count - known, truncated ? " (truncated)" : "");
+    fflush(stdout);
+}
+
+
+/* poll every root until ctrl-c, crawling the ones that got new quotes */
+void watch_roots(const char** root_uris, int roots_count, int threads, int print_links,
+                 double min_interval, double max_interval) {
+    struct watched_root* roots = calloc(roots_count, sizeof(struct watched_root));
+    struct watch watch = { roots, threads, print_links };
+    watcher = watcher_create(crawler, min_interval, max_interval);
+    for (int i = 0; i < roots_count; i++) {
+        roots[i].uri = root_uris[i];
+        roots[i].actor_did = get_did_from_uri(root_uris[i]);
+        roots[i].post_id = strdup(strrchr(root_uris[i], '/') + 1);
+        watcher_add(watcher, root_uris[i]);
+    }
 
-    printf("%d\n", qsp.all_quotes_count);
+    watcher_run(watcher, on_growth, &watch);
+
+    watcher_free(watcher);
+    watcher = NULL;
+    for (int i = 0; i < roots_count; i++) {
+        for (int j = 0; j < roots[i].quotes_count; j++) free(roots[i].quotes[j]);
+        free(roots[i].quotes);
+        free(roots[i].actor_did);
+        free(roots[i].post_id);
+    }
+    free(roots);
+}
+
+
+/* ctrl-c stops the crawl but still prints what we've got */
+void handle_sigint(int sig) {
+    (void)sig;
+    if (watcher) watcher_stop(watcher);
+    cancel_quote_search(crawler);
+}
+
+
+void usage(const char* program) {
+    fprintf(stderr, "usage: %s [-r] [-e budget] [-d depth] [-n nodes] [-q requests] [-t seconds]\n"
+                    "       [-c connections] [-w workers] [-j threads] [-M megabytes[:megabytes]] [-G megabytes] [-m]\n"
+                    "       [-f format [-o file] [-z]] [-s file] [-D file [-B rows]] [-L name] [-O]\n"
+                    "       [-H seconds] [-K k] [-A file [-T seconds]] [-N] [-P file [-E seconds]]\n"
+                    "       [-C file [-R | -U]] [-W seconds[:seconds]] [post-url...]\n"
+                    "       %s -X old_snapshot new_snapshot\n", program, program);
+    fprintf(stderr, "  -r          revalidate zero quote counts through getPosts before pruning\n");
+    fprintf(stderr, "  -e budget   only estimate the cascade size, spending at most `budget` requests\n");
+    fprintf(stderr, "  -d depth    don't expand quotes deeper than `depth`\n");
+    fprintf(stderr, "  -n nodes    stop after `nodes` quotes\n");
+    fprintf(stderr, "  -q requests stop after `requests` requests\n");
+    fprintf(stderr, "  -t seconds  stop after `seconds` seconds\n");
+    fprintf(stderr, "  -c count    keep up to `count` requests in flight\n");
+    fprintf(stderr, "  -w count    parse responses on `count` threads\n");
+    fprintf(stderr, "  -j threads  crawl on `threads` work-stealing workers (implied by several post-urls)\n");
+    fprintf(stderr, "  -M mem[:disk] keep at most `mem` MB of pending requests in memory, spilling the rest to\n"
+                    "              $TMPDIR. stop once `disk` MB are spilled as well\n");
+    fprintf(stderr, "  -G megabytes shed caches, pending requests and concurrency to stay around `megabytes` MB\n");
+    fprintf(stderr, "  -m          print where the crawl's memory went\n");
+    fprintf(stderr, "  -f format   write every quote as `ndjson` or `csv`, or the quote graph as `dot`,\n"
+                    "              `graphml` or `gexf`, instead of printing links\n");
+    fprintf(stderr, "  -o file     write formatted output to `file` instead of stdout\n");
+    fprintf(stderr, "  -z          zstd-compress formatted output\n");
+    fprintf(stderr, "  -s file     also save the crawl as a binary snapshot to `file`\n");
+    fprintf(stderr, "  -D file     also load the crawl into the SQLite database `file`\n");
+    fprintf(stderr, "  -B rows     commit to the database every `rows` rows (default %d)\n", DEFAULT_DATABASE_BATCH);
+    fprintf(stderr, "  -L name     publish results live to the shared memory segment `name` (like /quotes)\n");
+    fprintf(stderr, "  -O          print links oldest first, once the crawl is over\n");
+    fprintf(stderr, "  -H seconds  print how many quotes were posted per `seconds`\n");
+    fprintf(stderr, "  -K k        print the `k` most quoted and most liked quotes, and the `k` most active authors\n");
+    fprintf(stderr, "  -A file     remember handle -> DID lookups in `file` across runs\n");
+    fprintf(stderr, "  -T seconds  refresh remembered DIDs older than `seconds` (default %d)\n", DEFAULT_DID_CACHE_TTL);
+    fprintf(stderr, "  -N          print links with handles instead of DIDs\n");
+    fprintf(stderr, "  -P file     keep API responses in `file` across runs\n");
+    fprintf(stderr, "  -E seconds  revalidate kept responses older than `seconds` (default %d)\n", DEFAULT_HTTP_CACHE_TTL);
+    fprintf(stderr, "  -C file     checkpoint the crawl to `file` as it goes\n");
+    fprintf(stderr, "  -R          resume the crawl checkpointed in -C's file\n");
+    fprintf(stderr, "  -U          bring the crawl checkpointed in -C's file up to date, printing only new quotes\n");
+    fprintf(stderr, "  -W min[:max] watch the posts, crawling them again whenever their quote count grows.\n"
+                    "              quiet posts are polled less and less often, from every `min` seconds\n"
+                    "              to every `max` (default %d)\n", DEFAULT_WATCH_MAX_INTERVAL);
+    fprintf(stderr, "  -X file     print how the snapshot given instead of a url differs from snapshot `file`\n");
+}
+
+
+int main(int argc, char* argv[]) {
+    int estimate_budget = 0;
+    struct crawler_config config = {0};
+    int threads = 0;
+    const char* format = NULL;
+    const char* output_path = NULL;
+    int compress = 0;
+    const char* snapshot_path = NULL;
+    const char* diff_path = NULL;
+    const char* database_path = NULL;
+    int database_batch = 0;
+    const char* live_name = NULL;
+    int oldest_first = 0;
+    double histogram_seconds = 0;
+    int top_k = 0;
+    int memory_report = 0;
+    double watch_min = 0;
+    double watch_max = DEFAULT_WATCH_MAX_INTERVAL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "re:d:n:q:t:c:w:j:M:G:mf:o:zs:D:B:L:OH:K:A:T:NP:E:C:RUW:X:h")) != -1) {
+        switch (opt) {
+        case 'r': config.revalidate_leaves = 1; break;
+        case 'e': estimate_budget = atoi(optarg); break;
+        case 'd': config.limits.max_depth = atoi(optarg); break;
+        case 'n': config.limits.max_nodes = atoi(optarg); break;
+        case 'q': config.limits.max_requests = atoi(optarg); break;
+        case 't': config.limits.deadline_seconds = atof(optarg); break;
+        case 'c': config.max_in_flight = atoi(optarg); break;
+        case 'w': config.parse_workers = atoi(optarg); break;
+        case 'j': threads = atoi(optarg); break;
+        case 'M': {
+            /* megabytes */
+            char* end;
+            config.frontier_memory = strtod(optarg, &end) * (1 << 20);
+            if (*end == ':') config.spill_budget = atof(end + 1) * (1 << 20);
+            break;
+        }
+        case 'G': config.memory_budget = atof(optarg) * (1 << 20); break;
+        case 'm': memory_report = 1; break;
+        case 'f': format = optarg; break;
+        case 'o': output_path = optarg; break;
+        case 'z': compress = 1; break;
+        case 's': snapshot_path = optarg; break;
+        case 'D': database_path = optarg; break;
+        case 'B': database_batch = atoi(optarg); break;
+        case 'L': live_name = optarg; break;
+        case 'O': oldest_first = 1; break;
+        case 'H': histogram_seconds = atof(optarg); break;
+        case 'K': top_k = atoi(optarg); break;
+        case 'A': config.did_cache_path = optarg; break;
+        case 'T': config.did_cache_ttl = atof(optarg); break;
+        case 'P': config.http_cache_path = optarg; break;
+        case 'E': config.http_cache_ttl = atof(optarg); break;
+        case 'C': config.checkpoint_path = optarg; break;
+        case 'R': config.resume = 1; break;
+        case 'U': config.incremental = 1; break;
+        case 'W': {
+            char* end;
+            watch_min = strtod(optarg, &end);
+            if (*end == ':') watch_max = atof(end + 1);
+            if (watch_min <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        }
+        case 'X': diff_path = optarg; break;
+        case 'N': resolver = malloc(sizeof(struct handle_resolver)); handle_resolver_init(resolver); break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+    /* a journal that starts over with every crawl would only ever hold the last one */
+    if (watch_min > 0 && config.checkpoint_path && !config.resume && !config.incremental) {
+        fprintf(stderr, "-W with -C needs -R or -U\n");
+        return 1;
+    }
+    if (diff_path) {
+        if (optind >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        return diff_snapshots(diff_path, argv[optind]);
+    }
+
+    const char* post_url = optind < argc ? argv[optind] : POST_URL;
+
+    static const char* FORMATS[] = { "ndjson", "csv", "dot", "graphml", "gexf" };
+    enum output_format output_format = OUTPUT_NDJSON;
+    if (format) {
+        int known = 0;
+        for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+            if (strcmp(format, FORMATS[i]) == 0) { output_format = (enum output_format)i; known = 1; }
+        }
+        if (!known) {
+            fprintf(stderr, "unknown format: %s\n", format);
+            return 1;
+        }
+    }
+
+    shared_curl_init();
+
+    crawler = crawler_create(&config);
+    if (crawler == NULL) return 1;
+
+    const char* actor = get_actor(post_url);
+    char* actor_did = get_did(crawler, actor);
+    char* post_id = extract_post_id(post_url);
+
+    /* every url given is a root. the first one doubles as the root of a single-root crawl */
+    int roots_count = argc - optind > 1 ? argc - optind : 1;
+    const char** root_uris = calloc(roots_count, sizeof(char*));
+    for (int i = 0; i < roots_count; i++) {
+        const char* root_url = i == 0 ? post_url : argv[optind + i];
+        const char* root_actor = i == 0 ? actor : get_actor(root_url);
+        char* root_did = i == 0 ? actor_did : get_did(crawler, root_actor);
+        char* root_post_id = extract_post_id(root_url);
+
+        char* root_uri = malloc(strlen(root_did) + strlen(root_post_id) + 64);
+        sprintf(root_uri, "at://%s/app.bsky.feed.post/%s", root_did, root_post_id);
+        root_uris[i] = root_uri;
+
+        free(root_post_id);
+        if (i > 0) { free(root_did); free((char*)root_actor); }
+    }
+
+    if (estimate_budget > 0) {
+        struct cascade_estimate est = estimate_cascade_size(crawler, actor_did, post_id, estimate_budget, 0);
+        printf("%.0f (%.0f - %.0f), %d probes, %d requests\n", est.size, est.low, est.high, est.probes, est.requests);
+
+        free(actor_did);
+        free(post_id);
+        free((char*)actor);
+        crawler_destroy(crawler);
+        shared_curl_destroy();
+        return 0;
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    struct crawl_sink sinks[6];
+    int sinks_count = 0;
+
+    struct snapshot_writer* snapshot = NULL;
+    if (snapshot_path) {
+        snapshot = snapshot_writer_create();
+        sinks[sinks_count++] = snapshot_writer_sink(snapshot);
+    }
+
+    struct database_writer* database = NULL;
+    if (database_path) {
+        database = database_writer_open(database_path, database_batch);
+        if (database == NULL) return 1;
+        sinks[sinks_count++] = database_writer_sink(database);
+    }
+
+    struct live_segment* live = NULL;
+    if (live_name) {
+        live = live_segment_create(live_name, 0);
+        if (live == NULL) return 1;
+        sinks[sinks_count++] = live_segment_sink(live);
+    }
+
+    /* post times come from the rkeys, no extra requests */
+    struct timeline timeline;
+    timeline_init(&timeline);
+    if (oldest_first || histogram_seconds > 0) sinks[sinks_count++] = timeline_sink(&timeline);
+
+    struct aggregator* aggregator = NULL;
+    if (top_k > 0) {
+        aggregator = aggregator_create(top_k);
+        sinks[sinks_count++] = aggregator_sink(aggregator);
+    }
+
+    /* rows go straight from the crawl into the writer, no per-quote copies */
+    struct output_writer* writer = NULL;
+    if (format) {
+        writer = output_writer_open(output_path, output_format, compress);
+        if (writer == NULL) return 1;
+        sinks[sinks_count++] = output_writer_sink(writer);
+    }
+
+    if (watch_min > 0) {
+        config.sinks = sinks;
+        config.sinks_count = sinks_count;
+        crawler_set_config(crawler, &config);
+
+        /* every crawl feeds the same sinks. whatever needs the whole picture comes once we stop */
+        watch_roots(root_uris, roots_count, threads, writer == NULL && !oldest_first, watch_min, watch_max);
+
+        if (writer && output_writer_close(writer) < 0) return 1;
+        if (oldest_first && writer == NULL) {
+            timeline_sort(&timeline);
+            for (size_t i = 0; i < timeline.count; i++) print_quote(timeline.uris[i]);
+            flush_quotes();
+        }
+        if (histogram_seconds > 0) print_histogram(&timeline, histogram_seconds);
+        if (aggregator) print_top(aggregator, top_k);
+        if (memory_report) print_memory();
+    } else if (writer) {
+        config.sinks = sinks;
+        config.sinks_count = sinks_count;
+        crawler_set_config(crawler, &config);
+
+        int truncated = threads > 0 || roots_count > 1
+            ? parallel_quote_search(crawler, root_uris, roots_count, threads, NULL, NULL, NULL, NULL)
+            : recursive_quote_search(crawler, actor_did, post_id, NULL, NULL, NULL, NULL);
+
+        int rows = output_writer_close(writer);
+        if (rows < 0) return 1;
+
+        if (histogram_seconds > 0) print_histogram(&timeline, histogram_seconds);
+        if (aggregator) print_top(aggregator, top_k);
+        if (memory_report) print_memory();
+
+        /* keep the count out of the data when the data goes to stdout */
+        fprintf(output_path ? stdout : stderr, "%d%s\n", rows, truncated ? " (truncated)" : "");
+    } else {
+        config.sinks = sinks;
+        config.sinks_count = sinks_count;
+        crawler_set_config(crawler, &config);
+
+        struct crawl_iterator* it = crawl_iterator_start(crawler, root_uris, roots_count, threads);
+        if (it == NULL) return 1;
+
+        struct result_record record;
+        while (crawl_iterator_next(it, &record)) {
+            if (!oldest_first) print_quote(record.uri);
+            result_record_free(&record);
+        }
+
+        struct crawl_summary summary;
+        int truncated = crawl_iterator_finish(it, &summary);
+
+        if (oldest_first) {
+            timeline_sort(&timeline);
+            for (size_t i = 0; i < timeline.count; i++) print_quote(timeline.uris[i]);
+        }
+        flush_quotes();
+        if (histogram_seconds > 0) print_histogram(&timeline, histogram_seconds);
+        if (aggregator) print_top(aggregator, top_k);
+        if (memory_report) print_memory();
+
+        printf("%d%s\n", summary.quotes, truncated ? " (truncated)" : "");
+    }
+
+    /* readers that are attached keep what they have */
+    if (live) {
+        live_segment_finish(live);
+        live_segment_destroy(live, 1);
+    }
+
+    if (database && database_writer_close(database) < 0) return 1;
+
+    timeline_free(&timeline);
+    if (resolver) {
+        handle_resolver_free(resolver);
+        free(resolver);
+    }
+    free(held_uris);
+    if (aggregator) aggregator_free(aggregator);
+
+    if (snapshot) {
+        int saved = snapshot_writer_save(snapshot, snapshot_path);
+        snapshot_writer_free(snapshot);
+        if (!saved) return 1;
+    }
 
-    free(qsp.all_quotes);
-    free(qsp.visited);
+    for (int i = 0; i < roots_count; i++) free((char*)root_uris[i]);
+    free(root_uris);
 
-    free((char*)qsp.actor_did);
-    free((char*)qsp.post_id);
+    free(actor_did);
+    free(post_id);
     free((char*)actor);
 
+    crawler_destroy(crawler);
     shared_curl_destroy();
 
     return 0;
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "pagecache.h"
+#include "strset.h"
+
+/* starting number of hash buckets */
+#define PAGE_CACHE_INITIAL_BUCKETS 256
+
+struct page {
+    struct page* chain;  /* next in the same bucket */
+    struct page* newer;  /* LRU neighbours */
+    struct page* older;
+    size_t hash;
+    double stored_at;
+    size_t size;
+    char* body;
+    char url[];
+};
+
+struct page_cache {
+    pthread_mutex_t mutex;
+    size_t budget;
+    double max_age;
+
+    struct page** buckets;
+    size_t buckets_count; /* always a power of two */
+
+    struct page* newest;
+    struct page* oldest;
+
+    struct page_cache_stats stats;
+};
+
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* what a page is charged against the budget */
+static size_t page_cost(const struct page* page) {
+    return sizeof(struct page) + strlen(page->url) + 1 + page->size + 1;
+}
+
+
+struct page_cache* page_cache_create(size_t budget_bytes, double max_age_seconds) {
+    struct page_cache* cache = calloc(1, sizeof(struct page_cache));
+    pthread_mutex_init(&cache->mutex, NULL);
+    cache->budget = budget_bytes;
+    cache->max_age = max_age_seconds;
+    cache->buckets_count = PAGE_CACHE_INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->buckets_count, sizeof(struct page*));
+    return cache;
+}
+
+
+void page_cache_free(struct page_cache* cache) {
+    if (cache == NULL) return;
+    struct page* page = cache->newest;
+    while (page) {
+        struct page* older = page->older;
+        free(page->body);
+        free(page);
+        page = older;
+    }
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+
+static struct page** find(struct page_cache* cache, const char* url, size_t hash) {
+    struct page** link = &cache->buckets[hash & (cache->buckets_count - 1)];
+    while (*link && ((*link)->hash != hash || strcmp((*link)->url, url) != 0)) link = &(*link)->chain;
+    return link;
+}
+
+
+static void unlink_lru(struct page_cache* cache, struct page* page) {
+    if (page->newer) page->newer->older = page->older; else cache->newest = page->older;
+    if (page->older) page->older->newer = page->newer; else cache->oldest = page->newer;
+    page->newer = page->older = NULL;
+}
+
+
+static void push_newest(struct page_cache* cache, struct page* page) {
+    page->older = cache->newest;
+    page->newer = NULL;
+    if (cache->newest) cache->newest->newer = page; else cache->oldest = page;
+    cache->newest = page;
+}
+
+
+/* drop the page `link` points at */
+static void remove_page(struct page_cache* cache, struct page** link) {
+    struct page* page = *link;
+    *link = page->chain;
+    unlink_lru(cache, page);
+    cache->stats.entries--;
+    cache->stats.bytes -= page_cost(page);
+    free(page->body);
+    free(page);
+}
+
+
+static void grow_buckets(struct page_cache* cache) {
+    size_t count = cache->buckets_count * 2;
+    struct page** buckets = calloc(count, sizeof(struct page*));
+    for (size_t i = 0; i < cache->buckets_count; i++) {
+        struct page* page = cache->buckets[i];
+        while (page) {
+            struct page* next = page->chain;
+            page->chain = buckets[page->hash & (count - 1)];
+            buckets[page->hash & (count - 1)] = page;
+            page = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->buckets_count = count;
+}
+
+
+/* drop the least recently used pages until the rest take at most `bytes`. caller holds the mutex */
+static void evict(struct page_cache* cache, size_t bytes) {
+    while (cache->stats.bytes > bytes && cache->oldest) {
+        struct page* oldest = cache->oldest;
+        remove_page(cache, find(cache, oldest->url, oldest->hash));
+        cache->stats.evictions++;
+    }
+}
+
+
+char* page_cache_get(struct page_cache* cache, const char* url, size_t* size) {
+    size_t hash = strset_hash(url);
+    char* body = NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    struct page** link = find(cache, url, hash);
+    struct page* page = *link;
+    if (page && cache->max_age > 0 && monotonic_now() - page->stored_at > cache->max_age) {
+        remove_page(cache, link);
+        page = NULL;
+    }
+    if (page) {
+        unlink_lru(cache, page);
+        push_newest(cache, page);
+        body = malloc(page->size + 1);
+        memcpy(body, page->body, page->size + 1);
+        *size = page->size;
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return body;
+}
+
+
+void page_cache_put(struct page_cache* cache, const char* url, const char* body, size_t size) {
+    size_t url_len = strlen(url);
+    struct page* page = malloc(sizeof(struct page) + url_len + 1);
+    memcpy(page->url, url, url_len + 1);
+    page->hash = strset_hash(url);
+    page->stored_at = monotonic_now();
+    page->size = size;
+    page->chain = page->newer = page->older = NULL;
+
+    size_t cost = page_cost(page);
+    if (cost > cache->budget) {
+        free(page);
+        return;
+    }
+    page->body = malloc(size + 1);
+    memcpy(page->body, body, size);
+    page->body[size] = '\0';
+
+    pthread_mutex_lock(&cache->mutex);
+
+    struct page** link = find(cache, url, page->hash);
+    if (*link) remove_page(cache, link);
+    evict(cache, cache->budget - cost);
+
+    if (cache->stats.entries >= cache->buckets_count) grow_buckets(cache);
+    struct page** bucket = &cache->buckets[page->hash & (cache->buckets_count - 1)];
+    page->chain = *bucket;
+    *bucket = page;
+    push_newest(cache, page);
+    cache->stats.entries++;
+    cache->stats.bytes += cost;
+
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+
+void page_cache_trim(struct page_cache* cache, size_t bytes) {
+    pthread_mutex_lock(&cache->mutex);
+    evict(cache, bytes);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+
+struct page_cache_stats page_cache_get_stats(struct page_cache* cache) {
+    pthread_mutex_lock(&cache->mutex);
+    struct page_cache_stats stats = cache->stats;
+    pthread_mutex_unlock(&cache->mutex);
+    return stats;
+}
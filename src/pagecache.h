@@ -0,0 +1,37 @@
+#ifndef   __PAGECACHE_H__
+#define   __PAGECACHE_H__
+
+#include <stddef.h>
+
+/* in-memory cache of getQuotes pages, keyed by request URL, for crawls run one after another in
+ * the same process. a subtree shared by several roots is then fetched by the first crawl that
+ * gets there and read from memory by the others. entries are evicted least recently used first
+ * once they take more than the byte budget. thread-safe, so any number of crawlers can share one */
+struct page_cache;
+
+struct page_cache_stats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes; /* what the entries take, bookkeeping included */
+};
+
+/* `max_age_seconds` > 0 makes older pages count as missing, for processes that run long enough
+ * for cascades to grow */
+struct page_cache* page_cache_create(size_t budget_bytes, double max_age_seconds);
+void page_cache_free(struct page_cache* cache);
+
+/* copy of the page cached for `url`, to be freed, with its length in `*size`. NULL if there is none */
+char* page_cache_get(struct page_cache* cache, const char* url, size_t* size);
+
+/* remember `body` as the page at `url`, evicting whatever it takes to stay in budget.
+ * pages bigger than the whole budget aren't kept */
+void page_cache_put(struct page_cache* cache, const char* url, const char* body, size_t size);
+
+/* evict least recently used pages until the rest take at most `bytes` */
+void page_cache_trim(struct page_cache* cache, size_t bytes);
+
+struct page_cache_stats page_cache_get_stats(struct page_cache* cache);
+
+#endif /* __PAGECACHE_H__ */
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+
+#include "queue.h"
+
+
+void bqueue_init(struct bqueue* q, int capacity) {
+    q->items = malloc(capacity * sizeof(void*));
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+
+void bqueue_destroy(struct bqueue* q) {
+    free(q->items);
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+}
+
+
+/* caller holds the mutex and made sure there is room */
+static void put_locked(struct bqueue* q, void* item) {
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+}
+
+
+/* caller holds the mutex and made sure there is something */
+static void* take_locked(struct bqueue* q) {
+    void* item = q->items[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    return item;
+}
+
+
+int bqueue_push(struct bqueue* q, void* item) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == q->capacity && !q->closed) pthread_cond_wait(&q->not_full, &q->mutex);
+
+    int pushed = !q->closed;
+    if (pushed) put_locked(q, item);
+    pthread_mutex_unlock(&q->mutex);
+    return pushed;
+}
+
+
+int bqueue_try_push(struct bqueue* q, void* item) {
+    pthread_mutex_lock(&q->mutex);
+    int pushed = !q->closed && q->count < q->capacity;
+    if (pushed) put_locked(q, item);
+    pthread_mutex_unlock(&q->mutex);
+    return pushed;
+}
+
+
+void* bqueue_pop(struct bqueue* q) {
+    pthread_mutex_lock(&q->mutex);
+    while (q->count == 0 && !q->closed) pthread_cond_wait(&q->not_empty, &q->mutex);
+
+    void* item = q->count > 0 ? take_locked(q) : NULL;
+    pthread_mutex_unlock(&q->mutex);
+    return item;
+}
+
+
+void* bqueue_try_pop(struct bqueue* q) {
+    pthread_mutex_lock(&q->mutex);
+    void* item = q->count > 0 ? take_locked(q) : NULL;
+    pthread_mutex_unlock(&q->mutex);
+    return item;
+}
+
+
+void bqueue_close(struct bqueue* q) {
+    pthread_mutex_lock(&q->mutex);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_cond_broadcast(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+}
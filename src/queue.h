@@ -0,0 +1,36 @@
+#ifndef   __QUEUE_H__
+#define   __QUEUE_H__
+
+#include <pthread.h>
+
+/* bounded blocking FIFO of pointers, safe for any number of producers and consumers */
+struct bqueue {
+    void** items;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+};
+
+void bqueue_init(struct bqueue* q, int capacity);
+void bqueue_destroy(struct bqueue* q);
+
+/* blocks while the queue is full. returns 0 if the queue got closed instead */
+int bqueue_push(struct bqueue* q, void* item);
+
+/* never blocks. returns 0 if the queue is full or closed */
+int bqueue_try_push(struct bqueue* q, void* item);
+
+/* blocks while the queue is empty. returns NULL once the queue is closed and drained */
+void* bqueue_pop(struct bqueue* q);
+
+/* never blocks. returns NULL if the queue is empty */
+void* bqueue_try_pop(struct bqueue* q);
+
+/* wake everyone up. pushes fail from now on, pops drain what's left */
+void bqueue_close(struct bqueue* q);
+
+#endif /* __QUEUE_H__ */
@@ -0,0 +1,110 @@
+#include <stdlib.h>
+
+#include "ring.h"
+
+
+void result_record_free(struct result_record* record) {
+    free(record->uri);
+    free(record->parent_uri);
+    free(record->author_did);
+    *record = (struct result_record){0};
+}
+
+
+void result_ring_init(struct result_ring* ring, size_t capacity) {
+    size_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+
+    ring->slots = calloc(rounded, sizeof(struct result_record));
+    ring->capacity = rounded;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->consumer_waiting, 0);
+    atomic_init(&ring->producer_waiting, 0);
+    pthread_mutex_init(&ring->mutex, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+}
+
+
+void result_ring_destroy(struct result_ring* ring) {
+    size_t head = atomic_load(&ring->head);
+    size_t tail = atomic_load(&ring->tail);
+    for (; head != tail; head++) result_record_free(&ring->slots[head & (ring->capacity - 1)]);
+
+    free(ring->slots);
+    pthread_mutex_destroy(&ring->mutex);
+    pthread_cond_destroy(&ring->cond);
+}
+
+
+/* wake the other side if it announced it's going to sleep. the announcement and our index update
+ * are both sequentially consistent, so either it sees the update or we see the announcement */
+static void wake(struct result_ring* ring, atomic_int* waiting) {
+    if (!atomic_load(waiting)) return;
+    pthread_mutex_lock(&ring->mutex);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+
+void result_ring_push(struct result_ring* ring, struct result_record record) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail - atomic_load(&ring->head) == ring->capacity) {
+        pthread_mutex_lock(&ring->mutex);
+        atomic_store(&ring->producer_waiting, 1);
+        while (tail - atomic_load(&ring->head) == ring->capacity) pthread_cond_wait(&ring->cond, &ring->mutex);
+        atomic_store(&ring->producer_waiting, 0);
+        pthread_mutex_unlock(&ring->mutex);
+    }
+
+    ring->slots[tail & (ring->capacity - 1)] = record;
+    atomic_store(&ring->tail, tail + 1);
+    wake(ring, &ring->consumer_waiting);
+}
+
+
+/* move the record at `head` out to the consumer */
+static int take(struct result_ring* ring, size_t head, struct result_record* record) {
+    struct result_record* slot = &ring->slots[head & (ring->capacity - 1)];
+    *record = *slot;
+    *slot = (struct result_record){0};
+    atomic_store(&ring->head, head + 1);
+    wake(ring, &ring->producer_waiting);
+    return 1;
+}
+
+
+int result_ring_pop(struct result_ring* ring, struct result_record* record) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (atomic_load(&ring->tail) == head) {
+        pthread_mutex_lock(&ring->mutex);
+        atomic_store(&ring->consumer_waiting, 1);
+        while (atomic_load(&ring->tail) == head && !atomic_load(&ring->closed)) {
+            pthread_cond_wait(&ring->cond, &ring->mutex);
+        }
+        atomic_store(&ring->consumer_waiting, 0);
+        pthread_mutex_unlock(&ring->mutex);
+
+        if (atomic_load(&ring->tail) == head) return 0;
+    }
+
+    return take(ring, head, record);
+}
+
+
+int result_ring_try_pop(struct result_ring* ring, struct result_record* record) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (atomic_load(&ring->tail) == head) return 0;
+    return take(ring, head, record);
+}
+
+
+void result_ring_close(struct result_ring* ring) {
+    pthread_mutex_lock(&ring->mutex);
+    atomic_store(&ring->closed, 1);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+}
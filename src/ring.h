@@ -0,0 +1,57 @@
+#ifndef   __RING_H__
+#define   __RING_H__
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* a quote found by the crawler. the strings belong to the record */
+struct result_record {
+    char* uri;        /* AT-URI of the quote */
+    char* parent_uri; /* AT-URI of the post it quotes */
+    char* author_did; /* may be NULL if the view didn't carry one */
+    int depth;        /* quotes of the root are at depth 1 */
+    int quote_count;  /* quoteCount of the quote itself, -1 if unknown */
+};
+
+void result_record_free(struct result_record* record);
+
+/* single-producer single-consumer ring of result records. pushing and popping are lock-free;
+ * the mutex and condition variable only come into play when one side has to sleep
+ * (consumer on an empty ring, producer on a full one). several producers are fine as long as
+ * they are serialized by something else */
+struct result_ring {
+    struct result_record* slots;
+    size_t capacity; /* power of two */
+
+    _Atomic size_t head; /* next slot the consumer reads. only the consumer writes it */
+    _Atomic size_t tail; /* next slot the producer writes. only the producer writes it */
+    atomic_int closed;
+
+    atomic_int consumer_waiting;
+    atomic_int producer_waiting;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+/* `capacity` gets rounded up to a power of two */
+void result_ring_init(struct result_ring* ring, size_t capacity);
+
+/* frees records that were never popped */
+void result_ring_destroy(struct result_ring* ring);
+
+/* hand a record over. the ring takes ownership of its strings. blocks while the ring is full,
+ * so nothing is ever dropped */
+void result_ring_push(struct result_ring* ring, struct result_record record);
+
+/* take the oldest record, blocking while the ring is empty. returns 0 once the ring is closed
+ * and every record was popped. the caller owns the popped record */
+int result_ring_pop(struct result_ring* ring, struct result_record* record);
+
+/* never blocks. returns 0 if the ring is empty right now */
+int result_ring_try_pop(struct result_ring* ring, struct result_record* record);
+
+/* the producer is done. wakes the consumer so it can drain what's left */
+void result_ring_close(struct result_ring* ring);
+
+#endif /* __RING_H__ */
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapdiff.h"
+#include "tid.h"
+
+/* rows of `snapshot` in key order. two stable radix passes, rkey then DID, sort by (DID, rkey) */
+static uint32_t* sorted_rows(const struct snapshot* snapshot) {
+    size_t n = snapshot->rows;
+    uint64_t* column = malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    uint32_t* rows = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+
+    for (size_t i = 0; i < n; i++) {
+        column[i] = snapshot->keys[i].rkey;
+        rows[i] = i;
+    }
+    tid_sort(column, rows, n);
+
+    for (size_t i = 0; i < n; i++) column[i] = snapshot->keys[rows[i]].did;
+    tid_sort(column, rows, n);
+
+    free(column);
+    return rows;
+}
+
+
+static int compare_keys(const struct snapshot_key* a, const struct snapshot_key* b) {
+    if (a->did != b->did) return a->did < b->did ? -1 : 1;
+    if (a->rkey != b->rkey) return a->rkey < b->rkey ? -1 : 1;
+    return 0;
+}
+
+
+/* whether `old_row` and `new_row` hang off the same post */
+static int same_parent(const struct snapshot* old_snapshot, size_t old_row,
+                       const struct snapshot* new_snapshot, size_t new_row) {
+    int32_t old_parent = old_snapshot->parents[old_row];
+    int32_t new_parent = new_snapshot->parents[new_row];
+    if (old_parent < 0 || new_parent < 0) return old_parent < 0 && new_parent < 0;
+    return compare_keys(&old_snapshot->keys[old_parent], &new_snapshot->keys[new_parent]) == 0;
+}
+
+
+void snapshot_diff(const struct snapshot* old_snapshot, const struct snapshot* new_snapshot,
+                   void (*on_change)(void* userdata, const struct post_change* change), void* userdata,
+                   struct snapshot_diff_summary* summary) {
+    *summary = (struct snapshot_diff_summary){0};
+
+    uint32_t* old_rows = sorted_rows(old_snapshot);
+    uint32_t* new_rows = sorted_rows(new_snapshot);
+    size_t old_count = old_snapshot->rows;
+    size_t new_count = new_snapshot->rows;
+
+    size_t i = 0, j = 0;
+    while (i < old_count || j < new_count) {
+        int cmp = i == old_count ? 1
+                : j == new_count ? -1
+                : compare_keys(&old_snapshot->keys[old_rows[i]], &new_snapshot->keys[new_rows[j]]);
+
+        struct post_change change = { .old_row = -1, .new_row = -1 };
+        if (cmp < 0) {
+            change.old_row = old_rows[i++];
+            summary->removed++;
+            if (old_snapshot->parents[change.old_row] >= 0) summary->edges_removed++;
+        } else if (cmp > 0) {
+            change.new_row = new_rows[j++];
+            summary->added++;
+            if (new_snapshot->parents[change.new_row] >= 0) summary->edges_added++;
+        } else {
+            change.old_row = old_rows[i++];
+            change.new_row = new_rows[j++];
+
+            int32_t old_quotes = old_snapshot->quote_counts[change.old_row];
+            int32_t new_quotes = new_snapshot->quote_counts[change.new_row];
+            if (old_quotes >= 0 && new_quotes >= 0) change.quote_count_delta = new_quotes - old_quotes;
+            change.parent_changed = !same_parent(old_snapshot, change.old_row, new_snapshot, change.new_row);
+
+            /* unchanged posts are the bulk of it and cost nothing but the comparison */
+            if (!change.parent_changed && change.quote_count_delta == 0) continue;
+
+            summary->changed++;
+            summary->quote_count_delta += change.quote_count_delta;
+            if (change.parent_changed) {
+                if (old_snapshot->parents[change.old_row] >= 0) summary->edges_removed++;
+                if (new_snapshot->parents[change.new_row] >= 0) summary->edges_added++;
+            }
+        }
+        if (on_change) on_change(userdata, &change);
+    }
+
+    free(old_rows);
+    free(new_rows);
+}
@@ -0,0 +1,33 @@
+#ifndef   __SNAPDIFF_H__
+#define   __SNAPDIFF_H__
+
+#include <stdint.h>
+
+#include "snapshot.h"
+
+/* how a post differs between two snapshots */
+struct post_change {
+    int64_t old_row;           /* row in the old snapshot, -1 if the post is new */
+    int64_t new_row;           /* row in the new snapshot, -1 if it's gone */
+    int parent_changed;        /* it's in both, but reached through a different quoted post */
+    int32_t quote_count_delta; /* new quoteCount minus old. 0 unless both are known */
+};
+
+struct snapshot_diff_summary {
+    size_t added;
+    size_t removed;
+    size_t changed;             /* in both, with a different parent or quoteCount */
+    size_t edges_added;
+    size_t edges_removed;
+    long long quote_count_delta; /* sum over the posts in both */
+};
+
+/* compare two snapshots post by post. both key columns get radix sorted into row order, then one
+ * merge pass over the two finds every difference, so the whole thing is linear in the rows of both.
+ * `on_change` (may be NULL) is called for every added, removed or changed post, in key order.
+ * every post has one edge, to its parent, and roots have none */
+void snapshot_diff(const struct snapshot* old_snapshot, const struct snapshot* new_snapshot,
+                   void (*on_change)(void* userdata, const struct post_change* change), void* userdata,
+                   struct snapshot_diff_summary* summary);
+
+#endif /* __SNAPDIFF_H__ */
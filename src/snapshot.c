@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+#include "intern.h"
+#include "tid.h"
+
+struct snapshot_writer {
+    struct intern_table posts;   /* AT-URI -> row */
+    struct intern_table authors; /* DID -> author id */
+    int truncated;
+
+    size_t capacity; /* rows the columns have room for */
+    struct snapshot_key* keys;
+    int32_t* parents;
+    uint32_t* author_ids;
+    int64_t* timestamps;
+    int32_t* quote_counts;
+    int32_t* depths;
+};
+
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+
+/* the DID and rkey parts of at://<did>/<collection>/<rkey>. NULL did if it isn't an AT-URI */
+static const char* split_uri(const char* uri, size_t* did_len, const char** rkey) {
+    if (strncmp(uri, "at://", 5) != 0) return NULL;
+    const char* did = uri + 5;
+    const char* did_end = strchr(did, '/');
+    if (did_end == NULL) return NULL;
+
+    *did_len = did_end - did;
+    *rkey = strrchr(uri, '/') + 1;
+    return did;
+}
+
+
+static uint64_t hash_bytes(const char* data, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+struct snapshot_key snapshot_key_of(const char* uri) {
+    size_t did_len;
+    const char* rkey;
+    const char* did = split_uri(uri, &did_len, &rkey);
+    if (did == NULL) return (struct snapshot_key){ 0, hash_bytes(uri, strlen(uri)) | (1ULL << 63) };
+
+    struct snapshot_key key = { hash_bytes(did, did_len), 0 };
+    if (!tid_decode(rkey, &key.rkey)) key.rkey = hash_bytes(rkey, strlen(rkey)) | (1ULL << 63);
+    return key;
+}
+
+
+char* snapshot_uri(const struct snapshot* snapshot, size_t row) {
+    uint64_t rkey = snapshot->keys[row].rkey;
+    if (rkey >> 63) return NULL;
+
+    char tid[TID_LEN + 1];
+    tid_encode(rkey, tid);
+
+    const char* did = snapshot_author(snapshot, row);
+    char* uri = malloc(strlen(did) + TID_LEN + 32);
+    sprintf(uri, "at://%s/app.bsky.feed.post/%s", did, tid);
+    return uri;
+}
+
+
+struct snapshot_writer* snapshot_writer_create(void) {
+    struct snapshot_writer* writer = calloc(1, sizeof(struct snapshot_writer));
+    intern_init(&writer->posts);
+    intern_init(&writer->authors);
+    return writer;
+}
+
+
+void snapshot_writer_free(struct snapshot_writer* writer) {
+    intern_free(&writer->posts);
+    intern_free(&writer->authors);
+    free(writer->keys);
+    free(writer->parents);
+    free(writer->author_ids);
+    free(writer->timestamps);
+    free(writer->quote_counts);
+    free(writer->depths);
+    free(writer);
+}
+
+
+/* row of `uri`, added with nothing known about it yet if it's new */
+static int post_row(struct snapshot_writer* writer, const char* uri, const char* author_did) {
+    size_t rows = writer->posts.count;
+    int row = intern_add(&writer->posts, uri);
+    if ((size_t)row < rows) return row;
+
+    if (writer->posts.count > writer->capacity) {
+        writer->capacity = writer->capacity ? writer->capacity * 2 : 1024;
+        writer->keys = realloc(writer->keys, writer->capacity * sizeof(*writer->keys));
+        writer->parents = realloc(writer->parents, writer->capacity * sizeof(*writer->parents));
+        writer->author_ids = realloc(writer->author_ids, writer->capacity * sizeof(*writer->author_ids));
+        writer->timestamps = realloc(writer->timestamps, writer->capacity * sizeof(*writer->timestamps));
+        writer->quote_counts = realloc(writer->quote_counts, writer->capacity * sizeof(*writer->quote_counts));
+        writer->depths = realloc(writer->depths, writer->capacity * sizeof(*writer->depths));
+    }
+
+    /* a post's author is the repo in its URI, for posts the crawl only saw as a parent */
+    char* uri_did = NULL;
+    if (author_did == NULL) {
+        size_t did_len;
+        const char* rkey;
+        const char* did = split_uri(uri, &did_len, &rkey);
+        uri_did = did ? strndup(did, did_len) : strdup("");
+        author_did = uri_did;
+    }
+
+    writer->keys[row] = snapshot_key_of(uri);
+    writer->parents[row] = -1;
+    writer->author_ids[row] = (uint32_t)intern_add(&writer->authors, author_did);
+    writer->timestamps[row] = writer->keys[row].rkey >> 63 ? 0 : tid_timestamp(writer->keys[row].rkey);
+    writer->quote_counts[row] = -1;
+    writer->depths[row] = 0;
+
+    free(uri_did);
+    return row;
+}
+
+
+static void collect_result(void* userdata, const struct quote_result* result) {
+    struct snapshot_writer* writer = userdata;
+
+    int parent = post_row(writer, result->parent_uri, NULL);
+    int row = post_row(writer, result->uri, result->author_did);
+
+    writer->parents[row] = parent;
+    writer->quote_counts[row] = result->quote_count;
+    writer->depths[row] = result->depth;
+}
+
+
+static void collect_summary(void* userdata, const struct crawl_summary* summary) {
+    struct snapshot_writer* writer = userdata;
+    writer->truncated |= summary->truncated;
+}
+
+
+struct crawl_sink snapshot_writer_sink(struct snapshot_writer* writer) {
+    return (struct crawl_sink){
+        .on_result = collect_result,
+        .on_complete = collect_summary,
+        .userdata = writer
+    };
+}
+
+
+/* write a column and pad it out to the next 8-byte boundary */
+static int write_column(FILE* file, const void* data, size_t size) {
+    static const char padding[8] = {0};
+    if (size > 0 && fwrite(data, size, 1, file) != 1) return 0;
+    size_t pad = align8(size) - size;
+    return pad == 0 || fwrite(padding, pad, 1, file) == 1;
+}
+
+
+int snapshot_writer_save(struct snapshot_writer* writer, const char* path) {
+    size_t rows = writer->posts.count;
+    size_t authors = writer->authors.count;
+
+    /* author names go into the heap back to back */
+    uint64_t* author_names = malloc((authors + 1) * sizeof(uint64_t));
+    size_t heap_size = 0;
+    for (size_t i = 0; i < authors; i++) {
+        author_names[i] = heap_size;
+        heap_size += strlen(intern_string(&writer->authors, i)) + 1;
+    }
+
+    struct snapshot_header header = {
+        .version = SNAPSHOT_VERSION,
+        .flags = writer->truncated ? SNAPSHOT_TRUNCATED : 0,
+        .rows = rows,
+        .authors = authors,
+        .heap_size = heap_size
+    };
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+
+    size_t offset = align8(sizeof(header));
+    header.keys_offset = offset;         offset += align8(rows * sizeof(struct snapshot_key));
+    header.parents_offset = offset;      offset += align8(rows * sizeof(int32_t));
+    header.author_ids_offset = offset;   offset += align8(rows * sizeof(uint32_t));
+    header.timestamps_offset = offset;   offset += align8(rows * sizeof(int64_t));
+    header.quote_counts_offset = offset; offset += align8(rows * sizeof(int32_t));
+    header.depths_offset = offset;       offset += align8(rows * sizeof(int32_t));
+    header.author_names_offset = offset; offset += align8(authors * sizeof(uint64_t));
+    header.heap_offset = offset;
+
+    char* tmp_path = malloc(strlen(path) + 8);
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        perror(tmp_path);
+        free(tmp_path);
+        free(author_names);
+        return 0;
+    }
+
+    int ok = write_column(file, &header, sizeof(header))
+          && write_column(file, writer->keys, rows * sizeof(struct snapshot_key))
+          && write_column(file, writer->parents, rows * sizeof(int32_t))
+          && write_column(file, writer->author_ids, rows * sizeof(uint32_t))
+          && write_column(file, writer->timestamps, rows * sizeof(int64_t))
+          && write_column(file, writer->quote_counts, rows * sizeof(int32_t))
+          && write_column(file, writer->depths, rows * sizeof(int32_t))
+          && write_column(file, author_names, authors * sizeof(uint64_t));
+    for (size_t i = 0; ok && i < authors; i++) {
+        const char* name = intern_string(&writer->authors, i);
+        ok = fwrite(name, strlen(name) + 1, 1, file) == 1;
+    }
+    free(author_names);
+
+    if (fclose(file) != 0) ok = 0;
+    if (ok && rename(tmp_path, path) != 0) {
+        perror(path);
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "failed to write snapshot %s\n", path);
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
+
+
+/* does [offset, offset + size) lie inside a file of `file_size` bytes */
+static int fits(uint64_t offset, uint64_t size, size_t file_size) {
+    return offset <= file_size && size <= file_size - offset && offset % 8 == 0;
+}
+
+
+int snapshot_open(const char* path, struct snapshot* snapshot) {
+    *snapshot = (struct snapshot){0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct snapshot_header)) {
+        fprintf(stderr, "%s: not a snapshot\n", path);
+        close(fd);
+        return 0;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 0;
+    }
+
+    const struct snapshot_header* header = map;
+    size_t size = st.st_size;
+    uint64_t rows = header->rows;
+    uint64_t authors = header->authors;
+
+    /* the row count is bounded by the file size, so none of the products below overflow */
+    int valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0
+             && header->version == SNAPSHOT_VERSION
+             && rows <= size && authors <= size
+             && fits(header->keys_offset, rows * sizeof(struct snapshot_key), size)
+             && fits(header->parents_offset, rows * sizeof(int32_t), size)
+             && fits(header->author_ids_offset, rows * sizeof(uint32_t), size)
+             && fits(header->timestamps_offset, rows * sizeof(int64_t), size)
+             && fits(header->quote_counts_offset, rows * sizeof(int32_t), size)
+             && fits(header->depths_offset, rows * sizeof(int32_t), size)
+             && fits(header->author_names_offset, authors * sizeof(uint64_t), size)
+             && fits(header->heap_offset, header->heap_size, size)
+             && (header->heap_size == 0 || ((const char*)map)[header->heap_offset + header->heap_size - 1] == '\0');
+    if (!valid) {
+        fprintf(stderr, "%s: not a version %d snapshot, or damaged\n", path, SNAPSHOT_VERSION);
+        munmap(map, size);
+        return 0;
+    }
+
+    /* every reference between columns has to land inside them, or readers run off the mapping */
+    const char* base = map;
+    const int32_t* parents = (const int32_t*)(base + header->parents_offset);
+    const uint32_t* author_ids = (const uint32_t*)(base + header->author_ids_offset);
+    const uint64_t* author_names = (const uint64_t*)(base + header->author_names_offset);
+    for (uint64_t i = 0; valid && i < rows; i++) {
+        valid = parents[i] >= -1 && parents[i] < (int64_t)rows && author_ids[i] < authors;
+    }
+    for (uint64_t i = 0; valid && i < authors; i++) valid = author_names[i] < header->heap_size;
+    if (!valid) {
+        fprintf(stderr, "%s: damaged snapshot\n", path);
+        munmap(map, size);
+        return 0;
+    }
+
+    *snapshot = (struct snapshot){
+        .map = map,
+        .size = size,
+        .header = header,
+        .rows = rows,
+        .authors = authors,
+        .keys = (const struct snapshot_key*)(base + header->keys_offset),
+        .parents = (const int32_t*)(base + header->parents_offset),
+        .author_ids = (const uint32_t*)(base + header->author_ids_offset),
+        .timestamps = (const int64_t*)(base + header->timestamps_offset),
+        .quote_counts = (const int32_t*)(base + header->quote_counts_offset),
+        .depths = (const int32_t*)(base + header->depths_offset),
+        .author_names = (const uint64_t*)(base + header->author_names_offset),
+        .heap = base + header->heap_offset
+    };
+    return 1;
+}
+
+
+void snapshot_close(struct snapshot* snapshot) {
+    if (snapshot->map) munmap(snapshot->map, snapshot->size);
+    *snapshot = (struct snapshot){0};
+}
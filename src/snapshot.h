@@ -0,0 +1,98 @@
+#ifndef   __SNAPSHOT_H__
+#define   __SNAPSHOT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crawler.h"
+
+/*
+ * binary snapshot of a crawl, laid out in columns so it can be mmap()ed and used in place:
+ *
+ *   header | keys | parents | author ids | timestamps | quote counts | depths | author names | heap
+ *
+ * every column starts 8-aligned and has one entry per row, except author names which has one per
+ * author. roots are rows too, with parent -1. numbers are in the byte order of the machine that
+ * wrote the file
+ */
+
+#define SNAPSHOT_MAGIC   "QCSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+
+/* header flags */
+#define SNAPSHOT_TRUNCATED 1 /* the crawl stopped early, the cascade is incomplete */
+
+/* a post, comparable across snapshots. sorting by it groups posts by author, then by time */
+struct snapshot_key {
+    uint64_t did;  /* FNV-1a of the author DID */
+    uint64_t rkey; /* the rkey decoded as a TID, or FNV-1a of it with the top bit set if it isn't one */
+};
+
+struct snapshot_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t rows;
+    uint64_t authors;
+    uint64_t heap_size;
+
+    /* where each column starts, in bytes from the start of the file */
+    uint64_t keys_offset;         /* struct snapshot_key */
+    uint64_t parents_offset;      /* int32_t row of the quoted post, -1 for roots */
+    uint64_t author_ids_offset;   /* uint32_t index into author names */
+    uint64_t timestamps_offset;   /* int64_t microseconds since the epoch, from the TID. 0 if unknown */
+    uint64_t quote_counts_offset; /* int32_t quoteCount, -1 if unknown */
+    uint64_t depths_offset;       /* int32_t, roots are at 0 */
+    uint64_t author_names_offset; /* uint64_t offset of each author's DID in the heap */
+    uint64_t heap_offset;         /* NUL-terminated strings */
+};
+
+/* an open snapshot. every pointer points into the mapping */
+struct snapshot {
+    void* map;
+    size_t size;
+    const struct snapshot_header* header;
+    size_t rows;
+    size_t authors;
+
+    const struct snapshot_key* keys;
+    const int32_t* parents;
+    const uint32_t* author_ids;
+    const int64_t* timestamps;
+    const int32_t* quote_counts;
+    const int32_t* depths;
+    const uint64_t* author_names;
+    const char* heap;
+};
+
+/* map `path` read-only. checks the header, that every column fits in the file, and that parents
+ * and authors point at rows and names that exist. returns 0 if it can't be used */
+int snapshot_open(const char* path, struct snapshot* snapshot);
+void snapshot_close(struct snapshot* snapshot);
+
+/* DID of the author of `row` */
+static inline const char* snapshot_author(const struct snapshot* snapshot, size_t row) {
+    return snapshot->heap + snapshot->author_names[snapshot->author_ids[row]];
+}
+
+/* AT-URI of `row`, to be freed. NULL if its rkey wasn't a TID and can't be spelled out again */
+char* snapshot_uri(const struct snapshot* snapshot, size_t row);
+
+/* the key a post with this AT-URI gets */
+struct snapshot_key snapshot_key_of(const char* uri);
+
+
+/* collects a crawl through its sink and writes it out as a snapshot */
+struct snapshot_writer;
+
+struct snapshot_writer* snapshot_writer_create(void);
+void snapshot_writer_free(struct snapshot_writer* writer);
+
+/* a sink feeding the writer. callbacks must not run concurrently, which the crawler guarantees */
+struct crawl_sink snapshot_writer_sink(struct snapshot_writer* writer);
+
+/* write everything collected so far to `path`, in one sequential pass. goes through a temporary
+ * file that is renamed over `path`, so readers never see half a snapshot. returns 0 on failure */
+int snapshot_writer_save(struct snapshot_writer* writer, const char* path);
+
+#endif /* __SNAPSHOT_H__ */
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "spill.h"
+
+struct segment {
+    FILE* file;
+    size_t records; /* not read yet */
+    size_t bytes;   /* written to it, headers included */
+    int sealed;     /* flushed and rewound for reading, never written to again */
+    struct segment* next;
+};
+
+struct spill {
+    char* dir;
+    size_t segment_bytes;
+
+    /* read from `oldest`, written to `newest`. a segment that's being read is never written to */
+    struct segment* oldest;
+    struct segment* newest;
+
+    size_t count;
+    size_t bytes;
+};
+
+
+struct spill* spill_create(const char* dir, size_t segment_bytes) {
+    if (dir == NULL) dir = getenv("TMPDIR");
+    if (dir == NULL || *dir == '\0') dir = "/tmp";
+
+    struct spill* spill = calloc(1, sizeof(struct spill));
+    spill->dir = strdup(dir);
+    spill->segment_bytes = segment_bytes > 0 ? segment_bytes : DEFAULT_SPILL_SEGMENT_BYTES;
+    return spill;
+}
+
+
+static void free_segment(struct segment* segment) {
+    fclose(segment->file);
+    free(segment);
+}
+
+
+void spill_free(struct spill* spill) {
+    if (spill == NULL) return;
+    struct segment* segment = spill->oldest;
+    while (segment) {
+        struct segment* next = segment->next;
+        free_segment(segment);
+        segment = next;
+    }
+    free(spill->dir);
+    free(spill);
+}
+
+
+static struct segment* open_segment(struct spill* spill) {
+    size_t path_size = strlen(spill->dir) + 32;
+    char* path = malloc(path_size);
+    snprintf(path, path_size, "%s/spill-XXXXXX", spill->dir);
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror(path);
+        free(path);
+        return NULL;
+    }
+    /* the open descriptor keeps it alive until we're done with it */
+    unlink(path);
+    free(path);
+
+    struct segment* segment = calloc(1, sizeof(struct segment));
+    segment->file = fdopen(fd, "w+");
+    if (segment->file == NULL) {
+        perror("fdopen");
+        close(fd);
+        free(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+
+int spill_push(struct spill* spill, const void* record, size_t size) {
+    struct segment* segment = spill->newest;
+    if (segment == NULL || segment->sealed || segment->bytes >= spill->segment_bytes) {
+        segment = open_segment(spill);
+        if (segment == NULL) return 0;
+        if (spill->newest) spill->newest->next = segment; else spill->oldest = segment;
+        spill->newest = segment;
+    }
+
+    uint32_t header = size;
+    long offset = ftell(segment->file);
+    if (fwrite(&header, sizeof(header), 1, segment->file) != 1 || fwrite(record, 1, size, segment->file) != size) {
+        perror("spill");
+        /* forget the partial record, so the next one doesn't land behind it */
+        clearerr(segment->file);
+        fseek(segment->file, offset, SEEK_SET);
+        return 0;
+    }
+
+    segment->records++;
+    segment->bytes += sizeof(header) + size;
+    spill->count++;
+    spill->bytes += sizeof(header) + size;
+    return 1;
+}
+
+
+void* spill_pop(struct spill* spill, size_t* size) {
+    struct segment* segment = spill->oldest;
+    if (segment == NULL) return NULL;
+
+    /* first read from this segment, whether or not it's still the one we write to. its file
+     * position is still at the end of the writes, so seal it and start from its beginning */
+    if (!segment->sealed) {
+        if (fflush(segment->file) != 0) perror("spill");
+        rewind(segment->file);
+        segment->sealed = 1;
+    }
+
+    uint32_t header;
+    void* record = NULL;
+    if (fread(&header, sizeof(header), 1, segment->file) == 1) {
+        record = malloc(header + 1);
+        if (fread(record, 1, header, segment->file) != header) {
+            free(record);
+            record = NULL;
+        }
+    }
+    if (record == NULL) {
+        perror("spill");
+        return NULL;
+    }
+
+    ((char*)record)[header] = '\0';
+    *size = header;
+    spill->count--;
+    spill->bytes -= sizeof(header) + header;
+
+    /* read through. the space goes back to the disk right away */
+    if (--segment->records == 0) {
+        spill->oldest = segment->next;
+        if (segment == spill->newest) spill->newest = NULL;
+        free_segment(segment);
+    }
+    return record;
+}
+
+
+size_t spill_count(const struct spill* spill) {
+    return spill->count;
+}
+
+
+size_t spill_bytes(const struct spill* spill) {
+    return spill->bytes;
+}
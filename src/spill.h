@@ -0,0 +1,34 @@
+#ifndef   __SPILL_H__
+#define   __SPILL_H__
+
+#include <stddef.h>
+
+/* how big a segment file gets before the next one is started, unless told otherwise */
+#define DEFAULT_SPILL_SEGMENT_BYTES (4 << 20)
+
+/*
+ * FIFO of byte records kept on disk. records are appended to the newest of a chain of segment
+ * files and read back in order from the oldest, so the disk only ever sees sequential writes and
+ * reads. a segment is gone as soon as it's read through. segments are unlinked right after they
+ * are created, so nothing is left behind whichever way the process ends. not thread-safe
+ */
+struct spill;
+
+/* segments go to directory `dir`, NULL for $TMPDIR or /tmp. `segment_bytes` 0 picks a default */
+struct spill* spill_create(const char* dir, size_t segment_bytes);
+void spill_free(struct spill* spill);
+
+/* append a record. returns 0 if it couldn't be written, in which case the spill is unchanged */
+int spill_push(struct spill* spill, const void* record, size_t size);
+
+/* the oldest record, to be freed, with its length in `*size`. NULL if there is none or the disk
+ * failed us */
+void* spill_pop(struct spill* spill, size_t* size);
+
+/* records pushed and not popped yet */
+size_t spill_count(const struct spill* spill);
+
+/* what those records take on disk */
+size_t spill_bytes(const struct spill* spill);
+
+#endif /* __SPILL_H__ */
@@ -0,0 +1,74 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "strset.h"
+
+/* starting number of slots */
+#define STRSET_INITIAL_CAPACITY 64
+
+
+size_t strset_hash(const char* key) {
+    size_t hash = 14695981039346656037ULL;
+    for (; *key; key++) {
+        hash ^= (unsigned char)*key;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+void strset_init(struct strset* set) {
+    set->slots = calloc(STRSET_INITIAL_CAPACITY, sizeof(char*));
+    set->capacity = STRSET_INITIAL_CAPACITY;
+    set->count = 0;
+}
+
+
+void strset_free(struct strset* set) {
+    for (size_t i = 0; i < set->capacity; i++) free(set->slots[i]);
+    free(set->slots);
+    set->slots = NULL;
+    set->capacity = set->count = 0;
+}
+
+
+/* slot holding `key`, or the empty slot it would go into */
+static size_t find_slot(char** slots, size_t capacity, const char* key) {
+    size_t i = strset_hash(key) & (capacity - 1);
+    while (slots[i] != NULL && strcmp(slots[i], key) != 0) i = (i + 1) & (capacity - 1);
+    return i;
+}
+
+
+/* double the table. keys move over without being copied again */
+static void grow(struct strset* set) {
+    size_t capacity = set->capacity * 2;
+    char** slots = calloc(capacity, sizeof(char*));
+
+    for (size_t i = 0; i < set->capacity; i++) {
+        if (set->slots[i] == NULL) continue;
+        slots[find_slot(slots, capacity, set->slots[i])] = set->slots[i];
+    }
+
+    free(set->slots);
+    set->slots = slots;
+    set->capacity = capacity;
+}
+
+
+int strset_contains(const struct strset* set, const char* key) {
+    return set->slots[find_slot(set->slots, set->capacity, key)] != NULL;
+}
+
+
+int strset_insert(struct strset* set, const char* key) {
+    /* keep the load factor under 3/4 */
+    if ((set->count + 1) * 4 > set->capacity * 3) grow(set);
+
+    size_t i = find_slot(set->slots, set->capacity, key);
+    if (set->slots[i] != NULL) return 0;
+
+    set->slots[i] = strdup(key);
+    set->count++;
+    return 1;
+}
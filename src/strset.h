@@ -0,0 +1,25 @@
+#ifndef   __STRSET_H__
+#define   __STRSET_H__
+
+#include <stddef.h>
+
+/* open-addressing hash set of strings. keys are copied in. not thread-safe */
+struct strset {
+    char** slots;
+    size_t capacity; /* always a power of two */
+    size_t count;
+};
+
+void strset_init(struct strset* set);
+void strset_free(struct strset* set);
+
+/* returns 1 if `key` is in the set */
+int strset_contains(const struct strset* set, const char* key);
+
+/* returns 1 if `key` was added, 0 if it was already there */
+int strset_insert(struct strset* set, const char* key);
+
+/* FNV-1a. also used by anything else that hashes post keys */
+size_t strset_hash(const char* key);
+
+#endif /* __STRSET_H__ */
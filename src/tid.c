@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tid.h"
+
+static const char TID_ALPHABET[] = "234567abcdefghijklmnopqrstuvwxyz";
+
+
+/* value of one base32-sortable digit, -1 if it isn't one */
+static int digit_value(char c) {
+    if (c >= '2' && c <= '7') return c - '2';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 6;
+    return -1;
+}
+
+
+int tid_decode(const char* rkey, uint64_t* tid) {
+    uint64_t value = 0;
+    for (int i = 0; i < TID_LEN; i++) {
+        int digit = digit_value(rkey[i]);
+        if (digit < 0) return 0;
+        value = (value << 5) | (uint64_t)digit;
+    }
+    if (rkey[TID_LEN] != '\0') return 0;
+
+    /* 13 digits carry 65 bits, and the top bit of a TID is 0. the first digit may only use its low 3 */
+    if (digit_value(rkey[0]) >= 8) return 0;
+
+    *tid = value;
+    return 1;
+}
+
+
+void tid_encode(uint64_t tid, char out[TID_LEN + 1]) {
+    for (int i = TID_LEN - 1; i >= 0; i--) {
+        out[i] = TID_ALPHABET[tid & 31];
+        tid >>= 5;
+    }
+    out[TID_LEN] = '\0';
+}
+
+
+void tid_sort(uint64_t* tids, uint32_t* values, size_t n) {
+    if (n < 2) return;
+
+    /* counts for all 8 byte positions in one pass */
+    size_t (*counts)[256] = calloc(8, sizeof(*counts));
+    for (size_t i = 0; i < n; i++) {
+        for (int byte = 0; byte < 8; byte++) counts[byte][(tids[i] >> (byte * 8)) & 0xff]++;
+    }
+
+    uint64_t* tids_tmp = malloc(n * sizeof(uint64_t));
+    uint32_t* values_tmp = values ? malloc(n * sizeof(uint32_t)) : NULL;
+    uint64_t* from_tids = tids;
+    uint32_t* from_values = values;
+    uint64_t* to_tids = tids_tmp;
+    uint32_t* to_values = values_tmp;
+
+    for (int byte = 0; byte < 8; byte++) {
+        int shift = byte * 8;
+
+        /* every key has the same byte here, the pass wouldn't move anything */
+        if (counts[byte][(from_tids[0] >> shift) & 0xff] == n) continue;
+
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            offsets[b] = offset;
+            offset += counts[byte][b];
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            size_t to = offsets[(from_tids[i] >> shift) & 0xff]++;
+            to_tids[to] = from_tids[i];
+            if (values) to_values[to] = from_values[i];
+        }
+
+        uint64_t* swap_tids = from_tids; from_tids = to_tids; to_tids = swap_tids;
+        uint32_t* swap_values = from_values; from_values = to_values; to_values = swap_values;
+    }
+
+    /* an odd number of passes leaves the result in the scratch buffers */
+    if (from_tids != tids) {
+        memcpy(tids, from_tids, n * sizeof(uint64_t));
+        if (values) memcpy(values, from_values, n * sizeof(uint32_t));
+    }
+
+    free(counts);
+    free(tids_tmp);
+    free(values_tmp);
+}
@@ -0,0 +1,28 @@
+#ifndef   __TID_H__
+#define   __TID_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* post record keys are TIDs: 13 base32-sortable characters packing a 64-bit integer whose top
+ * bit is 0, then 53 bits of microseconds since the epoch, then a 10-bit clock id. the integer
+ * sorts the same way the string does */
+#define TID_LEN 13
+
+/* decode `rkey` into `tid`. returns 0 if it isn't a TID */
+int tid_decode(const char* rkey, uint64_t* tid);
+
+/* the 13 characters of `tid` plus a terminator */
+void tid_encode(uint64_t tid, char out[TID_LEN + 1]);
+
+/* microseconds since the epoch */
+static inline int64_t tid_timestamp(uint64_t tid) {
+    return (int64_t)(tid >> 10);
+}
+
+/* sort `tids` ascending, which is oldest first, moving `values` (may be NULL) along with them.
+ * LSD radix sort over bytes: linear in `n`, and bytes every key shares (the top ones, for posts
+ * from the same few days) cost nothing */
+void tid_sort(uint64_t* tids, uint32_t* values, size_t n);
+
+#endif /* __TID_H__ */
@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "timeline.h"
+#include "tid.h"
+
+/* histograms wider than this get coarser buckets instead */
+#define MAX_HISTOGRAM_BUCKETS (1 << 20)
+
+
+void timeline_init(struct timeline* timeline) {
+    *timeline = (struct timeline){0};
+}
+
+
+void timeline_free(struct timeline* timeline) {
+    for (size_t i = 0; i < timeline->count; i++) free(timeline->uris[i]);
+    free(timeline->uris);
+    free(timeline->tids);
+    *timeline = (struct timeline){0};
+}
+
+
+static void collect_quote(void* userdata, const struct quote_result* result) {
+    struct timeline* timeline = userdata;
+
+    if (timeline->count == timeline->capacity) {
+        timeline->capacity = timeline->capacity ? timeline->capacity * 2 : 1024;
+        timeline->tids = realloc(timeline->tids, timeline->capacity * sizeof(uint64_t));
+        timeline->uris = realloc(timeline->uris, timeline->capacity * sizeof(char*));
+    }
+
+    uint64_t tid;
+    const char* rkey = strrchr(result->uri, '/');
+    if (rkey == NULL || !tid_decode(rkey + 1, &tid)) tid = UINT64_MAX;
+
+    timeline->tids[timeline->count] = tid;
+    timeline->uris[timeline->count] = strdup(result->uri);
+    timeline->count++;
+}
+
+
+struct crawl_sink timeline_sink(struct timeline* timeline) {
+    return (struct crawl_sink){
+        .on_result = collect_quote,
+        .userdata = timeline
+    };
+}
+
+
+void timeline_sort(struct timeline* timeline) {
+    size_t n = timeline->count;
+    uint32_t* order = malloc(n * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+
+    /* sort the keys, then move the URIs by the permutation that falls out */
+    tid_sort(timeline->tids, order, n);
+
+    char** uris = malloc(n * sizeof(char*));
+    for (size_t i = 0; i < n; i++) uris[i] = timeline->uris[order[i]];
+    free(timeline->uris);
+    timeline->uris = uris;
+    free(order);
+}
+
+
+void timeline_histogram(const struct timeline* timeline, double bucket_seconds, struct time_histogram* histogram) {
+    *histogram = (struct time_histogram){ .bucket = (int64_t)(bucket_seconds * 1e6) };
+    if (histogram->bucket <= 0) histogram->bucket = 1;
+
+    int64_t first = INT64_MAX, last = INT64_MIN;
+    for (size_t i = 0; i < timeline->count; i++) {
+        if (timeline->tids[i] == UINT64_MAX) {
+            histogram->undated++;
+            continue;
+        }
+        int64_t t = tid_timestamp(timeline->tids[i]);
+        if (t < first) first = t;
+        if (t > last) last = t;
+    }
+    if (first > last) return;
+
+    while ((last - first) / histogram->bucket >= MAX_HISTOGRAM_BUCKETS) histogram->bucket *= 2;
+
+    histogram->start = first - first % histogram->bucket;
+    histogram->buckets = (int)((last - histogram->start) / histogram->bucket) + 1;
+    histogram->counts = calloc(histogram->buckets, sizeof(int));
+
+    for (size_t i = 0; i < timeline->count; i++) {
+        if (timeline->tids[i] == UINT64_MAX) continue;
+        histogram->counts[(tid_timestamp(timeline->tids[i]) - histogram->start) / histogram->bucket]++;
+    }
+}
+
+
+void time_histogram_free(struct time_histogram* histogram) {
+    free(histogram->counts);
+    *histogram = (struct time_histogram){0};
+}
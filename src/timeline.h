@@ -0,0 +1,41 @@
+#ifndef   __TIMELINE_H__
+#define   __TIMELINE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crawler.h"
+
+/* when the quotes of a crawl were posted, read off their TID rkeys. costs no requests */
+struct timeline {
+    uint64_t* tids;  /* UINT64_MAX for quotes whose rkey isn't a TID */
+    char** uris;
+    size_t count;
+    size_t capacity;
+};
+
+/* quotes per time bucket */
+struct time_histogram {
+    int64_t start;    /* microseconds since the epoch where bucket 0 starts */
+    int64_t bucket;   /* microseconds per bucket */
+    int* counts;
+    int buckets;
+    int undated;      /* quotes left out because their rkey isn't a TID */
+};
+
+void timeline_init(struct timeline* timeline);
+void timeline_free(struct timeline* timeline);
+
+/* a sink collecting into `timeline`. callbacks must not run concurrently, which the crawler
+ * guarantees */
+struct crawl_sink timeline_sink(struct timeline* timeline);
+
+/* put the quotes in the order they were posted, oldest first. undated ones go last */
+void timeline_sort(struct timeline* timeline);
+
+/* count quotes per `bucket_seconds`, from the oldest one to the newest one. buckets get wider if
+ * there would be absurdly many of them */
+void timeline_histogram(const struct timeline* timeline, double bucket_seconds, struct time_histogram* histogram);
+void time_histogram_free(struct time_histogram* histogram);
+
+#endif /* __TIMELINE_H__ */
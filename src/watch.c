@@ -0,0 +1,201 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "watch.h"
+
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+
+struct watched_post {
+    char* uri;
+    int quote_count; /* as last polled, -1 before that */
+    double interval; /* seconds until the next poll */
+    uint64_t due;    /* tick of the next poll */
+    int next;        /* next post in the same wheel slot, -1 at the end */
+};
+
+struct watcher {
+    struct crawler* crawler;
+    double min_interval;
+    double max_interval;
+    atomic_int stop;
+
+    struct watched_post* posts;
+    int posts_count;
+    int posts_capacity;
+
+    /* slot lists of post indices, -1 for empty. level n slots are 64^n ticks wide */
+    int wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t tick; /* the last tick that was processed */
+};
+
+
+struct watcher* watcher_create(struct crawler* crawler, double min_interval, double max_interval) {
+    struct watcher* watcher = calloc(1, sizeof(struct watcher));
+    watcher->crawler = crawler;
+    watcher->min_interval = min_interval >= 1 ? min_interval : 1;
+    watcher->max_interval = max_interval >= watcher->min_interval ? max_interval : watcher->min_interval;
+    atomic_init(&watcher->stop, 0);
+    memset(watcher->wheel, -1, sizeof(watcher->wheel));
+    return watcher;
+}
+
+
+void watcher_free(struct watcher* watcher) {
+    for (int i = 0; i < watcher->posts_count; i++) free(watcher->posts[i].uri);
+    free(watcher->posts);
+    free(watcher);
+}
+
+
+/* put post `id` in the slot of its due tick, on the lowest level whose range reaches that far.
+ * a post cascading down on its due tick lands in the level 0 slot advance() is about to drain */
+static void schedule(struct watcher* watcher, int id) {
+    struct watched_post* post = &watcher->posts[id];
+    uint64_t due = post->due >= watcher->tick ? post->due : watcher->tick;
+    uint64_t delta = due - watcher->tick;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) level++;
+
+    /* anything past the top level's reach waits in its furthest slot and gets rescheduled from there */
+    if (delta >= (1ULL << (WHEEL_BITS * WHEEL_LEVELS))) due = watcher->tick + (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+    int slot = (due >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    post->next = watcher->wheel[level][slot];
+    watcher->wheel[level][slot] = id;
+}
+
+
+/* move the posts of a higher level slot down to where they belong now */
+static void cascade(struct watcher* watcher, int level, int slot) {
+    int id = watcher->wheel[level][slot];
+    watcher->wheel[level][slot] = -1;
+    while (id >= 0) {
+        int next = watcher->posts[id].next;
+        schedule(watcher, id);
+        id = next;
+    }
+}
+
+
+/* process one tick. appends the posts due on it to `due` */
+static void advance(struct watcher* watcher, int** due, int* due_count, int* due_capacity) {
+    uint64_t tick = ++watcher->tick;
+
+    /* a lower level wrapped around. the next slot up spreads out over it */
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if ((tick & ((1ULL << (WHEEL_BITS * level)) - 1)) != 0) break;
+        cascade(watcher, level, (tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    }
+
+    int slot = tick & WHEEL_MASK;
+    int id = watcher->wheel[0][slot];
+    watcher->wheel[0][slot] = -1;
+    while (id >= 0) {
+        int next = watcher->posts[id].next;
+        if (watcher->posts[id].due > tick) {
+            schedule(watcher, id); /* parked in a far slot, not due yet */
+        } else {
+            if (*due_count == *due_capacity) {
+                *due_capacity = *due_capacity ? *due_capacity * 2 : 64;
+                *due = realloc(*due, *due_capacity * sizeof(int));
+            }
+            (*due)[(*due_count)++] = id;
+        }
+        id = next;
+    }
+}
+
+
+int watcher_add(struct watcher* watcher, const char* uri) {
+    if (watcher->posts_count == watcher->posts_capacity) {
+        watcher->posts_capacity = watcher->posts_capacity ? watcher->posts_capacity * 2 : 64;
+        watcher->posts = realloc(watcher->posts, watcher->posts_capacity * sizeof(struct watched_post));
+    }
+    int id = watcher->posts_count++;
+    watcher->posts[id] = (struct watched_post){
+        .uri = strdup(uri),
+        .quote_count = -1,
+        .interval = watcher->min_interval,
+        .due = watcher->tick + 1
+    };
+    schedule(watcher, id);
+    return id;
+}
+
+
+/* look up the counts of every due post in one go, and put each back on the wheel */
+static void poll_posts(struct watcher* watcher, const int* due, int due_count, watch_callback on_growth, void* userdata) {
+    const char** uris = malloc(due_count * sizeof(char*));
+    int* counts = malloc(due_count * sizeof(int));
+    for (int i = 0; i < due_count; i++) uris[i] = watcher->posts[due[i]].uri;
+
+    get_quote_counts(watcher->crawler, uris, due_count, counts);
+
+    for (int i = 0; i < due_count; i++) {
+        struct watched_post* post = &watcher->posts[due[i]];
+        int old_count = post->quote_count;
+
+        /* a failed lookup tells us nothing. try again on the same interval */
+        if (counts[i] >= 0) {
+            post->quote_count = counts[i];
+            if (counts[i] > (old_count > 0 ? old_count : 0)) {
+                post->interval = watcher->min_interval;
+                if (on_growth && !atomic_load(&watcher->stop)) on_growth(userdata, due[i], post->uri, old_count, counts[i]);
+            } else if (old_count >= 0) {
+                post->interval *= 2;
+                if (post->interval > watcher->max_interval) post->interval = watcher->max_interval;
+            }
+        }
+
+        /* the callback may have taken a while. count from now, not from when the poll started */
+        post->due = watcher->tick + (uint64_t)(post->interval + 0.5);
+        schedule(watcher, due[i]);
+    }
+
+    free(uris);
+    free(counts);
+}
+
+
+static double monotonic_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void watcher_run(struct watcher* watcher, watch_callback on_growth, void* userdata) {
+    int* due = NULL;
+    int due_count = 0;
+    int due_capacity = 0;
+
+    /* the next tick happens right away, and every second after that */
+    double start = monotonic_now() - watcher->tick;
+    while (!atomic_load(&watcher->stop)) {
+        /* catch up on every tick that passed, polling only once for all of them */
+        due_count = 0;
+        uint64_t elapsed = (uint64_t)(monotonic_now() - start);
+        while (watcher->tick <= elapsed) advance(watcher, &due, &due_count, &due_capacity);
+        if (due_count > 0) poll_posts(watcher, due, due_count, on_growth, userdata);
+
+        double next = start + watcher->tick;
+        double now = monotonic_now();
+        if (next > now && !atomic_load(&watcher->stop)) {
+            struct timespec ts = { (time_t)(next - now), (long)((next - now - (time_t)(next - now)) * 1e9) };
+            nanosleep(&ts, NULL); /* a signal cuts it short, which is fine */
+        }
+    }
+    free(due);
+}
+
+
+void watcher_stop(struct watcher* watcher) {
+    atomic_store(&watcher->stop, 1);
+}
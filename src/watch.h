@@ -0,0 +1,37 @@
+#ifndef   __WATCH_H__
+#define   __WATCH_H__
+
+#include "crawler.h"
+
+/*
+ * keeps an eye on the quoteCount of any number of posts without crawling them. every post is
+ * polled on its own interval: it starts at the minimum, doubles every time the count didn't
+ * move, up to the maximum, and drops back to the minimum as soon as it grows. due posts are
+ * looked up together, 25 per app.bsky.feed.getPosts call, so a quiet post costs a 25th of a
+ * request every now and then.
+ *
+ * polls are scheduled on a hierarchical timer wheel with one-second ticks: 4 levels of 64 slots
+ * cover intervals up to 194 days, and scheduling or expiring a post is O(1) however many are
+ * tracked
+ */
+struct watcher;
+
+/* called when a post's quoteCount grew, and the first time it's seen with quotes
+ * (`old_count` is -1 then). runs on the thread of watcher_run() */
+typedef void (*watch_callback)(void* userdata, int id, const char* uri, int old_count, int new_count);
+
+/* polls through `crawler`, which must stay alive while the watcher runs. intervals are seconds */
+struct watcher* watcher_create(struct crawler* crawler, double min_interval, double max_interval);
+void watcher_free(struct watcher* watcher);
+
+/* track the post at AT-URI `uri`. it's first polled on the next tick. returns its id, the
+ * number of posts tracked before it */
+int watcher_add(struct watcher* watcher, const char* uri);
+
+/* poll until watcher_stop() */
+void watcher_run(struct watcher* watcher, watch_callback on_growth, void* userdata);
+
+/* make watcher_run() return after what it's doing now. safe from any thread and signal handlers */
+void watcher_stop(struct watcher* watcher);
+
+#endif /* __WATCH_H__ */
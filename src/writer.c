@@ -0,0 +1,570 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "writer.h"
+#include "strset.h"
+
+/* size of each of the two buffers. big enough that the writer thread does few, large writes */
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+struct write_buffer {
+    char* data;
+    size_t len;
+    size_t capacity;
+};
+
+struct output_writer {
+    enum output_format format;
+    int fd;
+    int owns_fd;
+    int rows;
+    int failed; /* guarded by `mutex` while the writer thread runs */
+
+    struct strset roots; /* graph formats: roots already written as nodes */
+    FILE* edges;         /* gexf: edges wait here until every node is out */
+
+    struct write_buffer front; /* rows get formatted in here, crawling side only */
+    struct write_buffer back;  /* full buffer the writer thread is flushing */
+    int back_full;             /* `back` holds data that isn't written yet */
+    int closing;
+
+    pthread_t thread;
+    int started;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx* zstd;
+    char* compressed;
+    size_t compressed_size;
+#endif
+};
+
+
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("write");
+            return 0;
+        }
+        data += written;
+        len -= written;
+    }
+    return 1;
+}
+
+
+/* push `len` bytes to the output, compressing them first if asked to. `last` ends the stream */
+static int flush_bytes(struct output_writer* writer, const char* data, size_t len, int last) {
+#ifdef HAVE_ZSTD
+    if (writer->zstd) {
+        ZSTD_inBuffer in = { data, len, 0 };
+        ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        for (;;) {
+            ZSTD_outBuffer out = { writer->compressed, writer->compressed_size, 0 };
+            size_t remaining = ZSTD_compressStream2(writer->zstd, &out, &in, mode);
+            if (ZSTD_isError(remaining)) {
+                fprintf(stderr, "zstd: %s\n", ZSTD_getErrorName(remaining));
+                return 0;
+            }
+            if (!write_all(writer->fd, writer->compressed, out.pos)) return 0;
+
+            /* continue: done once the input is used up. end: done once the frame is complete */
+            if (last ? remaining == 0 : in.pos == in.size) return 1;
+        }
+    }
+#endif
+    (void)last;
+    return write_all(writer->fd, data, len);
+}
+
+
+static void* writer_main(void* arg) {
+    struct output_writer* writer = arg;
+
+    pthread_mutex_lock(&writer->mutex);
+    for (;;) {
+        while (!writer->back_full && !writer->closing) pthread_cond_wait(&writer->cond, &writer->mutex);
+        if (!writer->back_full) break;
+
+        /* the crawling side leaves `back` alone until back_full drops, so no lock needed */
+        int failed = writer->failed;
+        pthread_mutex_unlock(&writer->mutex);
+        int ok = failed || flush_bytes(writer, writer->back.data, writer->back.len, 0);
+        writer->back.len = 0;
+        pthread_mutex_lock(&writer->mutex);
+
+        if (!ok) writer->failed = 1;
+        writer->back_full = 0;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+
+/* hand the front buffer to the writer thread and take the empty one back.
+ * only waits if the writer is still busy with the previous buffer */
+static void swap_buffers(struct output_writer* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->back_full) pthread_cond_wait(&writer->cond, &writer->mutex);
+
+    struct write_buffer full = writer->front;
+    writer->front = writer->back;
+    writer->back = full;
+    writer->back_full = 1;
+
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+
+static void put(struct output_writer* writer, const char* data, size_t len) {
+    struct write_buffer* buffer = &writer->front;
+    if (buffer->len + len > buffer->capacity) {
+        if (buffer->len > 0) swap_buffers(writer);
+        buffer = &writer->front;
+
+        /* a single piece bigger than a whole buffer. never happens with real posts */
+        if (len > buffer->capacity) {
+            buffer->capacity = len;
+            buffer->data = realloc(buffer->data, buffer->capacity);
+        }
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+}
+
+
+static void put_str(struct output_writer* writer, const char* str) {
+    put(writer, str, strlen(str));
+}
+
+
+static void put_json_string(struct output_writer* writer, const char* str) {
+    if (str == NULL) {
+        put_str(writer, "null");
+        return;
+    }
+
+    put(writer, "\"", 1);
+    const char* run = str;
+    for (const char* c = str; *c; c++) {
+        if (*c != '"' && *c != '\\' && (unsigned char)*c >= 0x20) continue;
+
+        put(writer, run, c - run);
+        char escaped[8];
+        if (*c == '"' || *c == '\\') snprintf(escaped, sizeof(escaped), "\\%c", *c);
+        else snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+        put_str(writer, escaped);
+        run = c + 1;
+    }
+    put_str(writer, run);
+    put(writer, "\"", 1);
+}
+
+
+static void put_csv_field(struct output_writer* writer, const char* str) {
+    if (str == NULL) return;
+    if (strpbrk(str, ",\"\r\n") == NULL) {
+        put_str(writer, str);
+        return;
+    }
+
+    /* quoted, with quotes doubled */
+    put(writer, "\"", 1);
+    const char* run = str;
+    const char* quote;
+    while ((quote = strchr(run, '"'))) {
+        put(writer, run, quote - run + 1);
+        put(writer, "\"", 1);
+        run = quote + 1;
+    }
+    put_str(writer, run);
+    put(writer, "\"", 1);
+}
+
+
+/* https link of an AT-URI, written straight into the buffer instead of going through
+ * post_uri_to_https() and an allocation per row */
+static void put_link(struct output_writer* writer, const char* uri, int json) {
+    const char* did = strncmp(uri, "at://", 5) == 0 ? uri + 5 : NULL;
+    const char* did_end = did ? strchr(did, '/') : NULL;
+    const char* post_id = strrchr(uri, '/');
+    if (did_end == NULL) {
+        if (json) put_json_string(writer, uri);
+        else put_csv_field(writer, uri);
+        return;
+    }
+
+    /* DIDs and record keys never need escaping */
+    if (json) put(writer, "\"", 1);
+    put_str(writer, "https://bsky.app/profile/");
+    put(writer, did, did_end - did);
+    put_str(writer, "/post/");
+    put_str(writer, post_id + 1);
+    if (json) put(writer, "\"", 1);
+}
+
+
+static void put_xml_string(struct output_writer* writer, const char* str) {
+    const char* run = str;
+    for (const char* c = str; *c; c++) {
+        const char* entity;
+        switch (*c) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        default: continue;
+        }
+        put(writer, run, c - run);
+        put_str(writer, entity);
+        run = c + 1;
+    }
+    put_str(writer, run);
+}
+
+
+static void put_dot_string(struct output_writer* writer, const char* str) {
+    put(writer, "\"", 1);
+    const char* run = str;
+    for (const char* c = str; *c; c++) {
+        if (*c != '"' && *c != '\\') continue;
+        put(writer, run, c - run);
+        put(writer, "\\", 1);
+        run = c;
+    }
+    put_str(writer, run);
+    put(writer, "\"", 1);
+}
+
+
+/* a node of the quote graph. `author` may be NULL, `quote_count` -1 */
+static void write_node(struct output_writer* writer, const char* uri, const char* author, int depth, int quote_count) {
+    char numbers[96];
+
+    switch (writer->format) {
+    case OUTPUT_DOT:
+        put_str(writer, "  ");
+        put_dot_string(writer, uri);
+        snprintf(numbers, sizeof(numbers), " [depth=%d, quote_count=%d", depth, quote_count);
+        put_str(writer, numbers);
+        if (author) {
+            put_str(writer, ", author=");
+            put_dot_string(writer, author);
+        }
+        put_str(writer, "];\n");
+        break;
+    case OUTPUT_GRAPHML:
+        put_str(writer, "    <node id=\"");
+        put_xml_string(writer, uri);
+        snprintf(numbers, sizeof(numbers), "\"><data key=\"depth\">%d</data>", depth);
+        put_str(writer, numbers);
+        if (quote_count >= 0) {
+            snprintf(numbers, sizeof(numbers), "<data key=\"quote_count\">%d</data>", quote_count);
+            put_str(writer, numbers);
+        }
+        if (author) {
+            put_str(writer, "<data key=\"author\">");
+            put_xml_string(writer, author);
+            put_str(writer, "</data>");
+        }
+        put_str(writer, "</node>\n");
+        break;
+    case OUTPUT_GEXF:
+        put_str(writer, "      <node id=\"");
+        put_xml_string(writer, uri);
+        put_str(writer, "\" label=\"");
+        put_link(writer, uri, 0);
+        snprintf(numbers, sizeof(numbers), "\"><attvalues><attvalue for=\"0\" value=\"%d\"/>", depth);
+        put_str(writer, numbers);
+        if (quote_count >= 0) {
+            snprintf(numbers, sizeof(numbers), "<attvalue for=\"1\" value=\"%d\"/>", quote_count);
+            put_str(writer, numbers);
+        }
+        if (author) {
+            put_str(writer, "<attvalue for=\"2\" value=\"");
+            put_xml_string(writer, author);
+            put_str(writer, "\"/>");
+        }
+        put_str(writer, "</attvalues></node>\n");
+        break;
+    default:
+        break;
+    }
+}
+
+
+static void write_edge(struct output_writer* writer, const char* parent_uri, const char* child_uri) {
+    switch (writer->format) {
+    case OUTPUT_DOT:
+        put_str(writer, "  ");
+        put_dot_string(writer, parent_uri);
+        put_str(writer, " -> ");
+        put_dot_string(writer, child_uri);
+        put_str(writer, ";\n");
+        break;
+    case OUTPUT_GRAPHML:
+        put_str(writer, "    <edge source=\"");
+        put_xml_string(writer, parent_uri);
+        put_str(writer, "\" target=\"");
+        put_xml_string(writer, child_uri);
+        put_str(writer, "\"/>\n");
+        break;
+    case OUTPUT_GEXF:
+        /* a line per edge: id, parent, child. AT-URIs never contain spaces */
+        fprintf(writer->edges, "%d %s %s\n", writer->rows, parent_uri, child_uri);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* nodes and edges go out as they are found. the only thing kept around is the set of roots */
+static void write_graph_result(struct output_writer* writer, const struct quote_result* result) {
+    if (result->depth == 1 && strset_insert(&writer->roots, result->parent_uri)) {
+        write_node(writer, result->parent_uri, NULL, 0, -1);
+    }
+    write_node(writer, result->uri, result->author_did, result->depth, result->quote_count);
+    write_edge(writer, result->parent_uri, result->uri);
+}
+
+
+static void write_header(struct output_writer* writer) {
+    switch (writer->format) {
+    case OUTPUT_CSV:
+        put_str(writer, "uri,url,parent_uri,author,depth\n");
+        break;
+    case OUTPUT_DOT:
+        put_str(writer, "digraph quotes {\n");
+        break;
+    case OUTPUT_GRAPHML:
+        put_str(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+                        "  <key id=\"depth\" for=\"node\" attr.name=\"depth\" attr.type=\"int\"/>\n"
+                        "  <key id=\"quote_count\" for=\"node\" attr.name=\"quote_count\" attr.type=\"int\"/>\n"
+                        "  <key id=\"author\" for=\"node\" attr.name=\"author\" attr.type=\"string\"/>\n"
+                        "  <graph id=\"quotes\" edgedefault=\"directed\">\n");
+        break;
+    case OUTPUT_GEXF:
+        put_str(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<gexf xmlns=\"http://gexf.net/1.3\" version=\"1.3\">\n"
+                        "  <graph defaultedgetype=\"directed\">\n"
+                        "    <attributes class=\"node\">\n"
+                        "      <attribute id=\"0\" title=\"depth\" type=\"integer\"/>\n"
+                        "      <attribute id=\"1\" title=\"quote_count\" type=\"integer\"/>\n"
+                        "      <attribute id=\"2\" title=\"author\" type=\"string\"/>\n"
+                        "    </attributes>\n"
+                        "    <nodes>\n");
+        break;
+    default:
+        break;
+    }
+}
+
+
+/* gexf wants every node before the first edge, so the edges come back from the spill file now */
+static void write_spilled_edges(struct output_writer* writer) {
+    put_str(writer, "    </nodes>\n    <edges>\n");
+
+    rewind(writer->edges);
+    char* line = NULL;
+    size_t line_capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &line_capacity, writer->edges)) > 0) {
+        line[len - 1] = '\0';
+        char* parent_uri = strchr(line, ' ');
+        char* child_uri = parent_uri ? strchr(parent_uri + 1, ' ') : NULL;
+        if (child_uri == NULL) continue;
+        *parent_uri++ = '\0';
+        *child_uri++ = '\0';
+
+        put_str(writer, "      <edge id=\"");
+        put_str(writer, line);
+        put_str(writer, "\" source=\"");
+        put_xml_string(writer, parent_uri);
+        put_str(writer, "\" target=\"");
+        put_xml_string(writer, child_uri);
+        put_str(writer, "\"/>\n");
+    }
+    free(line);
+    if (ferror(writer->edges)) {
+        /* the writer thread is still running and reads it */
+        pthread_mutex_lock(&writer->mutex);
+        writer->failed = 1;
+        pthread_mutex_unlock(&writer->mutex);
+    }
+
+    put_str(writer, "    </edges>\n");
+}
+
+
+static void write_footer(struct output_writer* writer) {
+    switch (writer->format) {
+    case OUTPUT_DOT:
+        put_str(writer, "}\n");
+        break;
+    case OUTPUT_GRAPHML:
+        put_str(writer, "  </graph>\n</graphml>\n");
+        break;
+    case OUTPUT_GEXF:
+        write_spilled_edges(writer);
+        put_str(writer, "  </graph>\n</gexf>\n");
+        break;
+    default:
+        break;
+    }
+}
+
+
+static void write_result(void* userdata, const struct quote_result* result) {
+    struct output_writer* writer = userdata;
+    char depth[16];
+    snprintf(depth, sizeof(depth), "%d", result->depth);
+
+    switch (writer->format) {
+    case OUTPUT_NDJSON:
+        put_str(writer, "{\"uri\":");
+        put_json_string(writer, result->uri);
+        put_str(writer, ",\"url\":");
+        put_link(writer, result->uri, 1);
+        put_str(writer, ",\"parent_uri\":");
+        put_json_string(writer, result->parent_uri);
+        put_str(writer, ",\"author\":");
+        put_json_string(writer, result->author_did);
+        put_str(writer, ",\"depth\":");
+        put_str(writer, depth);
+        put_str(writer, "}\n");
+        break;
+    case OUTPUT_CSV:
+        put_csv_field(writer, result->uri);
+        put(writer, ",", 1);
+        put_link(writer, result->uri, 0);
+        put(writer, ",", 1);
+        put_csv_field(writer, result->parent_uri);
+        put(writer, ",", 1);
+        put_csv_field(writer, result->author_did);
+        put(writer, ",", 1);
+        put_str(writer, depth);
+        put(writer, "\n", 1);
+        break;
+    default:
+        write_graph_result(writer, result);
+        break;
+    }
+    writer->rows++;
+}
+
+
+struct output_writer* output_writer_open(const char* path, enum output_format format, int compress) {
+#ifndef HAVE_ZSTD
+    if (compress) {
+        fprintf(stderr, "compressed output needs a build with zstd (ZSTD=1)\n");
+        return NULL;
+    }
+#endif
+
+    int fd = STDOUT_FILENO;
+    if (path) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            perror(path);
+            return NULL;
+        }
+    }
+
+    struct output_writer* writer = calloc(1, sizeof(struct output_writer));
+    writer->format = format;
+    writer->fd = fd;
+    writer->owns_fd = path != NULL;
+    writer->front = (struct write_buffer){ malloc(WRITER_BUFFER_SIZE), 0, WRITER_BUFFER_SIZE };
+    writer->back = (struct write_buffer){ malloc(WRITER_BUFFER_SIZE), 0, WRITER_BUFFER_SIZE };
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+#ifdef HAVE_ZSTD
+    if (compress) {
+        writer->zstd = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(writer->zstd, ZSTD_c_compressionLevel, 3);
+        writer->compressed_size = ZSTD_CStreamOutSize();
+        writer->compressed = malloc(writer->compressed_size);
+    }
+#endif
+
+    strset_init(&writer->roots);
+    if (format == OUTPUT_GEXF) {
+        writer->edges = tmpfile();
+        if (writer->edges == NULL) {
+            perror("tmpfile");
+            writer->failed = 1;
+            output_writer_close(writer);
+            return NULL;
+        }
+    }
+    write_header(writer);
+
+    if (pthread_create(&writer->thread, NULL, writer_main, writer) != 0) {
+        fprintf(stderr, "Failed to create thread\n");
+        writer->failed = 1;
+        output_writer_close(writer);
+        return NULL;
+    }
+    writer->started = 1;
+    return writer;
+}
+
+
+struct crawl_sink output_writer_sink(struct output_writer* writer) {
+    return (struct crawl_sink){
+        .on_result = write_result,
+        .userdata = writer
+    };
+}
+
+
+int output_writer_close(struct output_writer* writer) {
+    if (writer->started) {
+        write_footer(writer);
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->closing = 1;
+        pthread_cond_broadcast(&writer->cond);
+        pthread_mutex_unlock(&writer->mutex);
+        pthread_join(writer->thread, NULL);
+    }
+
+    /* whatever is left in the front buffer, then the end of the stream */
+    if (!writer->failed && !flush_bytes(writer, writer->front.data, writer->front.len, 1)) writer->failed = 1;
+    if (writer->owns_fd && close(writer->fd) != 0) {
+        perror("close");
+        writer->failed = 1;
+    }
+
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(writer->zstd);
+    free(writer->compressed);
+#endif
+
+    int rows = writer->failed ? -1 : writer->rows;
+    strset_free(&writer->roots);
+    if (writer->edges) fclose(writer->edges);
+    free(writer->front.data);
+    free(writer->back.data);
+    pthread_mutex_destroy(&writer->mutex);
+    pthread_cond_destroy(&writer->cond);
+    free(writer);
+    return rows;
+}
@@ -0,0 +1,32 @@
+#ifndef   __WRITER_H__
+#define   __WRITER_H__
+
+#include "crawler.h"
+
+enum output_format {
+    OUTPUT_NDJSON, /* {"uri":...,"url":...,"parent_uri":...,"author":...,"depth":...} per line */
+    OUTPUT_CSV,    /* uri,url,parent_uri,author,depth with a header row */
+
+    /* the quote graph: a node per post (roots included) and a parent -> child edge per quote */
+    OUTPUT_DOT,
+    OUTPUT_GRAPHML,
+    OUTPUT_GEXF    /* edges are spilled to a temporary file until the nodes are out */
+};
+
+/* output stage for crawl results. rows are formatted into one of two large buffers on the
+ * crawling side while a writer thread flushes the other one, so the crawl never waits on the
+ * disk unless the disk falls a whole buffer behind. memory use doesn't grow with the crawl */
+struct output_writer;
+
+/* write to `path`, or stdout if NULL. `compress` zstd-compresses the stream, which needs a build
+ * with ZSTD=1. returns NULL if the file can't be opened or compression isn't available */
+struct output_writer* output_writer_open(const char* path, enum output_format format, int compress);
+
+/* a sink feeding the writer. callbacks must not run concurrently, which the crawler guarantees */
+struct crawl_sink output_writer_sink(struct output_writer* writer);
+
+/* flush everything, stop the writer thread and close the file. returns the number of rows
+ * written, -1 if anything failed along the way */
+int output_writer_close(struct output_writer* writer);
+
+#endif /* __WRITER_H__ */